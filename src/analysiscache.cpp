@@ -0,0 +1,278 @@
+#include "analysiscache.h"
+
+#include <SDL_log.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm> // copy_n, min, max
+#include <cerrno>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace groggle
+{
+namespace audio
+{
+
+static const char MAGIC[8] = { 'G', 'R', 'G', 'L', 'S', 'P', 'E', 'C' };
+static const uint32_t VERSION = 1;
+
+// Bump whenever Analyzer::transform() produces different numbers.
+static const uint32_t ANALYZER_VERSION = 2;
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ull;
+static const uint64_t FNV_PRIME = 1099511628211ull;
+
+// Cache files never leave the machine, so plain structs are good enough.
+struct SeriesHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t frameCount;
+    uint64_t paramsHash;
+    SeriesParams params;
+    uint32_t reserved;
+};
+
+static uint64_t fnv1a(const void *data, const size_t size, uint64_t hash = FNV_OFFSET)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t SeriesParams::hash() const
+{
+    uint64_t hash = fnv1a(&ANALYZER_VERSION, sizeof(ANALYZER_VERSION));
+    hash = fnv1a(&frameSize, sizeof(frameSize), hash);
+    hash = fnv1a(&binCount, sizeof(binCount), hash);
+    return fnv1a(&tickRate, sizeof(tickRate), hash);
+}
+
+// SpectrumSeries
+// ==============
+
+std::shared_ptr<SpectrumSeries> SpectrumSeries::open(const std::string &path, const SeriesParams &params)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SeriesHeader)) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping stays valid
+    if (data == MAP_FAILED) {
+        SDL_Log("Cannot map \"%s\": %s", path.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    std::shared_ptr<SpectrumSeries> series(new SpectrumSeries());
+    series->m_data = data;
+    series->m_size = info.st_size;
+
+    const SeriesHeader *header = reinterpret_cast<const SeriesHeader *>(data);
+    const size_t expectedSize = sizeof(SeriesHeader)
+        + static_cast<size_t>(header->frameCount) * header->params.binCount * sizeof(float);
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+        || header->version != VERSION
+        || header->paramsHash != params.hash()
+        || info.st_size != static_cast<off_t>(expectedSize)) {
+        return nullptr; // Unmapped by the destructor
+    }
+
+    series->m_params = header->params;
+    series->m_frameCount = header->frameCount;
+    series->m_bins = reinterpret_cast<const float *>(&header[1]);
+    return series;
+}
+
+SpectrumSeries::~SpectrumSeries()
+{
+    if (m_data) {
+        munmap(m_data, m_size);
+    }
+}
+
+Spectrum SpectrumSeries::at(const uint64_t timestamp) const
+{
+    if (m_frameCount == 0) {
+        return Spectrum();
+    }
+
+    const uint64_t ticks = timestamp * static_cast<double>(m_params.tickRate) / 1e9;
+    const uint32_t index = std::min<uint64_t>(ticks > 0 ? ticks - 1 : 0, m_frameCount - 1);
+    const float *bins = frame(index);
+    return Spectrum(bins, bins + m_params.binCount);
+}
+
+Spectrum SpectrumSeries::interpolated(const uint64_t timestamp) const
+{
+    if (m_frameCount == 0) {
+        return Spectrum();
+    }
+
+    // Tick i sits at (i + 1) / tickRate
+    const double position = std::max(timestamp * static_cast<double>(m_params.tickRate) / 1e9 - 1, 0.0);
+    const uint32_t index = std::min<uint64_t>(position, m_frameCount - 1);
+    const uint32_t nextIndex = std::min(index + 1, m_frameCount - 1);
+    const float *a = frame(index);
+    const float *b = frame(nextIndex);
+    return mix(Spectrum(a, a + m_params.binCount),
+               Spectrum(b, b + m_params.binCount),
+               position - index);
+}
+
+// SeriesWriter
+// ============
+
+SeriesWriter::SeriesWriter(const std::string &path, const SeriesParams &params)
+    : m_path(path)
+    , m_tempPath(path + ".tmp")
+    , m_params(params)
+{
+    m_file = fopen(m_tempPath.c_str(), "wb");
+    if (!m_file) {
+        SDL_Log("Cannot open \"%s\" for writing: %s", m_tempPath.c_str(), strerror(errno));
+        return;
+    }
+
+    // Placeholder, the frame count is only known on commit()
+    const SeriesHeader header = {};
+    m_failed = fwrite(&header, sizeof(header), 1, m_file) != 1;
+}
+
+SeriesWriter::~SeriesWriter()
+{
+    if (m_file) {
+        fclose(m_file);
+        unlink(m_tempPath.c_str());
+    }
+}
+
+bool SeriesWriter::append(const Spectrum &spectrum)
+{
+    if (!m_file || m_failed) {
+        return false;
+    }
+
+    // Spectrum is a deque, no contiguous storage to write in one go
+    m_bins.assign(m_params.binCount, 0);
+    std::copy_n(spectrum.begin(), std::min<size_t>(spectrum.size(), m_params.binCount), m_bins.begin());
+
+    m_failed = fwrite(m_bins.data(), sizeof(float), m_params.binCount, m_file) != m_params.binCount;
+    m_frameCount++;
+    return !m_failed;
+}
+
+bool SeriesWriter::commit()
+{
+    if (!m_file) {
+        return false;
+    }
+
+    SeriesHeader header = {};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.frameCount = m_frameCount;
+    header.paramsHash = m_params.hash();
+    header.params = m_params;
+
+    bool ok = !m_failed
+        && fseek(m_file, 0, SEEK_SET) == 0
+        && fwrite(&header, sizeof(header), 1, m_file) == 1;
+    ok = fclose(m_file) == 0 && ok;
+    m_file = nullptr;
+
+    if (!ok || rename(m_tempPath.c_str(), m_path.c_str()) != 0) {
+        SDL_Log("Cannot write \"%s\": %s", m_path.c_str(), strerror(errno));
+        unlink(m_tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// AnalysisCache
+// =============
+
+std::string AnalysisCache::defaultDirectory()
+{
+    if (const char *xdg = getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        return std::string(xdg) + "/groggle";
+    }
+
+    if (const char *home = getenv("HOME"); home && *home) {
+        return std::string(home) + "/.cache/groggle";
+    }
+
+    return "/tmp/groggle";
+}
+
+uint64_t AnalysisCache::hashFile(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return 0;
+    }
+
+    uint64_t hash = FNV_OFFSET;
+    std::vector<uint8_t> chunk(64 * 1024);
+    size_t count = 0;
+    while ((count = fread(chunk.data(), 1, chunk.size(), file)) > 0) {
+        hash = fnv1a(chunk.data(), count, hash);
+    }
+
+    const bool failed = ferror(file);
+    fclose(file);
+    return failed ? 0 : hash;
+}
+
+AnalysisCache::AnalysisCache(const std::string &directory)
+    : m_directory(directory)
+{}
+
+std::shared_ptr<SpectrumSeries> AnalysisCache::find(const uint64_t contentHash, const SeriesParams &params) const
+{
+    return SpectrumSeries::open(path(contentHash, params), params);
+}
+
+std::unique_ptr<SeriesWriter> AnalysisCache::create(const uint64_t contentHash, const SeriesParams &params) const
+{
+    // mkdir -p
+    size_t pos = 0;
+    do {
+        pos = m_directory.find('/', pos + 1);
+        const std::string dir = m_directory.substr(0, pos);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            SDL_Log("Cannot create \"%s\": %s", dir.c_str(), strerror(errno));
+            return nullptr;
+        }
+    } while (pos != std::string::npos);
+
+    auto writer = std::make_unique<SeriesWriter>(path(contentHash, params), params);
+    return writer->isOpen() ? std::move(writer) : nullptr;
+}
+
+std::string AnalysisCache::path(const uint64_t contentHash, const SeriesParams &params) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "%016" PRIx64 "-%016" PRIx64 ".spectra", contentHash, params.hash());
+    return m_directory + "/" + name;
+}
+
+}
+}
@@ -0,0 +1,119 @@
+#ifndef ANALYSISCACHE_H
+#define ANALYSISCACHE_H
+
+#include "spectrum.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace groggle
+{
+namespace audio
+{
+
+/**
+ * Everything that influences the analysis result. Changing any of it
+ * invalidates cached series.
+ */
+struct SeriesParams
+{
+    uint32_t frameSize = 0; // Analysis window in frames
+    uint32_t binCount = 0; // Spectrum size
+    float tickRate = 0; // Hz
+
+    uint64_t hash() const;
+};
+
+/**
+ * Memory mapped spectra of a whole track, one per analysis tick. Tick i
+ * belongs to the timestamp (i + 1) / tickRate, just like the Timer ticks.
+ *
+ * Layout: char magic[8] = "GRGLSPEC", uint32 version, uint32 frameCount,
+ * uint64 paramsHash, SeriesParams, then frameCount * binCount floats.
+ */
+class SpectrumSeries
+{
+public:
+    /// @return nullptr if the file is missing, broken or made with other params
+    static std::shared_ptr<SpectrumSeries> open(const std::string &path, const SeriesParams &params);
+    ~SpectrumSeries();
+
+    const SeriesParams &params() const { return m_params; }
+    uint32_t frameCount() const { return m_frameCount; }
+    const float *frame(const uint32_t index) const { return &m_bins[index * m_params.binCount]; }
+
+    /// The spectrum of the last tick at or before timestamp (ns).
+    Spectrum at(const uint64_t timestamp) const;
+
+    /// Blends the ticks around timestamp (ns), for output rates above tickRate.
+    Spectrum interpolated(const uint64_t timestamp) const;
+
+private:
+    SpectrumSeries() {}
+    SpectrumSeries(const SpectrumSeries&) = delete;
+    SpectrumSeries &operator=(const SpectrumSeries&) = delete;
+
+    void *m_data = nullptr;
+    size_t m_size = 0;
+    SeriesParams m_params;
+    uint32_t m_frameCount = 0;
+    const float *m_bins = nullptr;
+};
+
+/**
+ * Writes a series to a temporary file which only replaces the real one on
+ * commit(), so readers never see half a series.
+ */
+class SeriesWriter
+{
+public:
+    SeriesWriter(const std::string &path, const SeriesParams &params);
+    ~SeriesWriter();
+
+    bool isOpen() const { return m_file != nullptr; }
+    bool append(const Spectrum &spectrum);
+    bool commit();
+
+private:
+    SeriesWriter(const SeriesWriter&) = delete;
+    SeriesWriter &operator=(const SeriesWriter&) = delete;
+
+    const std::string m_path;
+    const std::string m_tempPath;
+    const SeriesParams m_params;
+    FILE *m_file = nullptr;
+    uint32_t m_frameCount = 0;
+    bool m_failed = false;
+    std::vector<float> m_bins; // Recycled
+};
+
+/**
+ * Analysis results of audio files, keyed by a hash of their content.
+ */
+class AnalysisCache
+{
+public:
+    /// $XDG_CACHE_HOME/groggle or ~/.cache/groggle
+    static std::string defaultDirectory();
+
+    /// FNV-1a over the file content, 0 if it cannot be read.
+    static uint64_t hashFile(const std::string &path);
+
+    AnalysisCache(const std::string &directory = defaultDirectory());
+
+    std::shared_ptr<SpectrumSeries> find(const uint64_t contentHash, const SeriesParams &params) const;
+    std::unique_ptr<SeriesWriter> create(const uint64_t contentHash, const SeriesParams &params) const;
+
+private:
+    std::string path(const uint64_t contentHash, const SeriesParams &params) const;
+
+    const std::string m_directory;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "analyzer.h"
+
+#include "audiosource.h"
+
+#include <algorithm> // min
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace groggle
+{
+namespace audio
+{
+
+static inline float magnitude(const float f[])
+{
+    return sqrt(pow(f[0], 2) + pow(f[1], 2));
+}
+
+Analyzer::Analyzer(const size_t frameSize)
+    : m_frameSize(frameSize)
+{
+    m_in = (float*)fftwf_malloc(sizeof(float) * m_frameSize);
+    m_out = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * (m_frameSize / 2 + 1));
+
+    // Planning is not thread safe and slow, only do it once.
+    m_plan = fftwf_plan_dft_r2c_1d(m_frameSize, m_in, m_out, FFTW_ESTIMATE);
+}
+
+Analyzer::~Analyzer()
+{
+    fftwf_destroy_plan(m_plan);
+    fftwf_free(m_out);
+    fftwf_free(m_in);
+}
+
+Spectrum Analyzer::transform(const int16_t data[], const int channels)
+{
+    // plan_dft_r2c modifies the input array, *must* copy here!
+    for (size_t i = 0; i < m_frameSize; i++) {
+        m_in[i] = data[i * channels] / (float)std::numeric_limits<int16_t>::max();
+    }
+
+    fftwf_execute(m_plan);
+
+    // "Realize", normalize and store the result
+    // Scaling: http://fftw.org/fftw3_doc/The-1d-Discrete-Fourier-Transform-_0028DFT_0029.html#The-1d-Discrete-Fourier-Transform-_0028DFT_0029
+    const float scaleFactor = 2.0f / m_frameSize;
+
+    // Store intensities for each frequency bucket at one point in time.
+    // Only copy the first half: positive frequencies. See above link. (Not sure about this.)
+    Spectrum spectrum;
+    const size_t binCount = Analyzer::binCount(m_frameSize, channels);
+    for (size_t i = 0; i < binCount; i++) {
+        spectrum.push_back(magnitude(m_out[i]) * scaleFactor);
+    }
+
+    // TODO Print something like a graphic equalizer? Render with SDL?
+
+    return spectrum;
+}
+
+uint64_t analyzeAll(AudioSource &source, Analyzer &analyzer, const float tickRate, TickCallback tick)
+{
+    const Format &format = source.format();
+    const size_t frameSize = analyzer.frameSize();
+    std::vector<int16_t> window(frameSize * format.channels, 0);
+
+    // Same tick positions as the timer: the first one after one interval
+    const double interval = 1.0 / tickRate;
+    uint64_t framesRead = 0;
+    uint64_t ticks = 0;
+    while ((ticks + 1) * interval <= format.duration) {
+        const double t = (ticks + 1) * interval;
+
+        // Slide the window forward up to the tick's position
+        const uint64_t target = t * format.rate;
+        while (framesRead < target) {
+            const size_t hop = std::min<uint64_t>(target - framesRead, frameSize);
+            memmove(window.data(), &window[hop * format.channels], (frameSize - hop) * format.channels * sizeof(int16_t));
+            const size_t count = source.read(&window[(frameSize - hop) * format.channels], hop);
+            framesRead += count;
+            if (count < hop) {
+                break;
+            }
+        }
+
+        if (framesRead < target) {
+            break; // Source ran dry early
+        }
+
+        tick(t * 1e9, analyzer.transform(window.data(), format.channels));
+        ticks++;
+    }
+
+    return ticks;
+}
+
+}
+}
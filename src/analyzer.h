@@ -0,0 +1,74 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include "spectrum.h"
+
+#include <fftw3.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace groggle
+{
+namespace audio
+{
+
+/**
+ * Turns windows of audio into spectra. FFTW buffers and the plan are set up
+ * once and recycled for every window.
+ */
+class Analyzer
+{
+public:
+    /**
+     * @param frameSize The amount of frames analyzed at a time. Also
+     * determines the frequency resolution of the Fourier transformation.
+     */
+    Analyzer(const size_t frameSize);
+    ~Analyzer();
+
+    size_t frameSize() const { return m_frameSize; }
+
+    /**
+     * Spectrum size for a window of interleaved audio. Divided by the channel
+     * count too, as groggle always did, so multichannel input keeps only the
+     * lower half of the positive frequencies.
+     */
+    static size_t binCount(const size_t frameSize, const int channels) { return frameSize / channels / 2; }
+
+    /**
+     * @param data frameSize() frames of interleaved s16 audio. Only the first
+     * channel is analyzed.
+     * @param channels Number of interleaved channels in data
+     * @return binCount(frameSize(), channels) magnitudes
+     */
+    Spectrum transform(const int16_t data[], const int channels);
+
+private:
+    Analyzer(const Analyzer&) = delete;
+    Analyzer &operator=(const Analyzer&) = delete;
+
+    const size_t m_frameSize;
+    float *m_in = nullptr;
+    fftwf_complex *m_out = nullptr;
+    fftwf_plan m_plan;
+};
+
+class AudioSource;
+
+typedef std::function<void(const uint64_t timestamp, const Spectrum &spectrum)> TickCallback;
+
+/**
+ * Reads a whole source as fast as possible and analyzes it at the positions
+ * a Timer with the given rate would have ticked at during playback.
+ * @param source Must support read()
+ * @param tick Called with the show time (ns) and the spectrum of every tick
+ * @return The number of ticks
+ */
+uint64_t analyzeAll(AudioSource &source, Analyzer &analyzer, const float tickRate, TickCallback tick);
+
+}
+}
+
+#endif
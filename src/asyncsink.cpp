@@ -0,0 +1,145 @@
+#include "asyncsink.h"
+
+#include <algorithm> // find, max
+#include <cstring>
+
+namespace groggle
+{
+
+AsyncSink::AsyncSink(std::shared_ptr<DmxSink> sink, const rt::ThreadPolicy &policy)
+    : m_sink(sink)
+    , m_policy(policy)
+{
+    // Last, everything it uses is set up
+    m_thread = std::thread(&AsyncSink::run, this);
+}
+
+AsyncSink::~AsyncSink()
+{
+    stopThread();
+}
+
+bool AsyncSink::close()
+{
+    stopThread();
+    return m_sink->close();
+}
+
+void AsyncSink::stopThread()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_changed.notify_all();
+    m_thread.join();
+}
+
+bool AsyncSink::send(const unsigned int universe, const ola::DmxBuffer &dmx)
+{
+    uint8_t channels[UNIVERSE_SIZE] = {};
+    unsigned int length = UNIVERSE_SIZE;
+    dmx.Get(channels, &length);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (merge(universe, channels)) {
+            m_dropped++;
+        }
+    }
+    m_changed.notify_all();
+    return !m_failing;
+}
+
+bool AsyncSink::sendFrame(const DmxFrame &frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        bool dropped = false;
+        for (size_t i = 0; i < frame.universes.size(); i++) {
+            dropped = merge(frame.universes[i], frame.data(i)) || dropped;
+        }
+        if (dropped) {
+            m_dropped++;
+        }
+    }
+    m_changed.notify_all();
+    return !m_failing;
+}
+
+bool AsyncSink::merge(const uint16_t universe, const uint8_t channels[])
+{
+    if (m_pending.universes.empty()) {
+        m_pendingSince = std::chrono::steady_clock::now();
+    }
+
+    const auto it = std::find(m_pending.universes.begin(), m_pending.universes.end(), universe);
+    const size_t index = it - m_pending.universes.begin();
+    const bool pending = it != m_pending.universes.end();
+    if (!pending) {
+        m_pending.universes.push_back(universe);
+        m_pending.channels.resize(m_pending.universes.size() * UNIVERSE_SIZE);
+    }
+
+    memcpy(&m_pending.channels[index * UNIVERSE_SIZE], channels, UNIVERSE_SIZE);
+    return pending;
+}
+
+bool AsyncSink::flush(const std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_changed.wait_for(lock, timeout, [this]() {
+        return m_pending.universes.empty() && !m_sending;
+    });
+}
+
+AsyncSink::Stats AsyncSink::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.dropped = m_dropped;
+    return stats;
+}
+
+void AsyncSink::run()
+{
+    rt::applyToCurrentThread("output", m_policy);
+
+    // Swapped with the slot, so neither side allocates once both have grown
+    DmxFrame sending;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_changed.wait(lock, [this]() { return m_stop || !m_pending.universes.empty(); });
+        if (m_pending.universes.empty()) {
+            break; // Stopped, and nothing left to send
+        }
+
+        std::swap(sending, m_pending);
+        m_pending.universes.clear();
+        m_pending.channels.clear();
+        const auto since = m_pendingSince;
+        m_sending = true;
+        lock.unlock();
+
+        const bool ok = m_sink->sendFrame(sending);
+        const long long latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - since).count();
+        m_failing = !ok;
+
+        lock.lock();
+        m_sending = false;
+        m_stats.frames++;
+        if (!ok) {
+            m_stats.failed++;
+        }
+        m_stats.maxLatency = std::max(m_stats.maxLatency, latency);
+        m_stats.meanLatency += (latency - m_stats.meanLatency) / m_stats.frames;
+        m_changed.notify_all(); // For flush()
+    }
+}
+
+}
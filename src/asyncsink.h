@@ -0,0 +1,85 @@
+#ifndef ASYNCSINK_H
+#define ASYNCSINK_H
+
+#include "dmxsink.h"
+#include "realtime.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace groggle
+{
+
+/**
+ * Hands frames to another sink from a thread of its own, so whoever renders
+ * never waits for a socket.
+ *
+ * Frames go into a single slot, the newest data per universe wins: universes
+ * that were not sent yet are overwritten and counted as dropped.
+ */
+class AsyncSink : public DmxSink
+{
+public:
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t failed = 0;
+        uint64_t dropped = 0;
+        long long maxLatency = 0; // ns, from handing in to sent
+        double meanLatency = 0; // ns
+    };
+
+    /// @param policy For the send thread
+    AsyncSink(std::shared_ptr<DmxSink> sink, const rt::ThreadPolicy &policy = rt::ThreadPolicy());
+    /// Sends what is left, then stops the thread.
+    ~AsyncSink();
+
+    /// @return false if the last send failed, this one happens later
+    bool send(const unsigned int universe, const ola::DmxBuffer &dmx) override;
+    bool sendFrame(const DmxFrame &frame) override;
+    /// Sends what is left, stops the thread and closes the sink.
+    bool close() override;
+
+    /**
+     * Blocks until everything handed in so far was sent.
+     * @return false on timeout
+     */
+    bool flush(const std::chrono::milliseconds timeout);
+
+    Stats stats() const;
+    /// Cheaper than stats(), for polling every frame.
+    uint64_t dropped() const { return m_dropped; }
+
+private:
+    AsyncSink(const AsyncSink&) = delete;
+    AsyncSink &operator=(const AsyncSink&) = delete;
+
+    void run();
+    /// Lets run() send what is left and waits for it, once.
+    void stopThread();
+    /// @return Whether the universe's previous data was still pending
+    bool merge(const uint16_t universe, const uint8_t channels[]);
+
+    std::shared_ptr<DmxSink> m_sink;
+    const rt::ThreadPolicy m_policy;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+    DmxFrame m_pending;
+    std::chrono::steady_clock::time_point m_pendingSince;
+    bool m_sending = false;
+    bool m_stop = false;
+
+    Stats m_stats;
+    std::atomic<uint64_t> m_dropped { 0 };
+    std::atomic<bool> m_failing { false };
+    std::thread m_thread;
+};
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include "audiosource.h"
+
+#include "generatorsource.h"
+#include "painput.h"
+#include "sdlinput.h"
+
+#include <SDL_log.h>
+
+#include <algorithm> // max
+
+namespace groggle
+{
+namespace audio
+{
+
+static const std::string GENERATOR_PREFIX = "gen:";
+
+// Keep about a second of audio around, plenty for one analysis window.
+static const size_t MIN_BUFFER_FRAMES = 4096;
+
+void AudioSource::setFormat(const Format &format)
+{
+    m_format = format;
+    const size_t capacity = std::max(static_cast<size_t>(format.rate), MIN_BUFFER_FRAMES);
+    m_buffer = std::make_shared<SampleBuffer>(capacity, format.channels);
+}
+
+void AudioSource::deliver(const int16_t samples[], const size_t frameCount)
+{
+    m_buffer->push(samples, frameCount);
+}
+
+static std::unique_ptr<AudioSource> tryOpen(std::unique_ptr<AudioSource> source)
+{
+    if (!source->open()) {
+        return nullptr;
+    }
+
+    const Format &format = source->format();
+    SDL_Log("Source: %s Rate: %i Hz Channels: %i Latency: %.1f ms",
+            source->name().c_str(),
+            format.rate,
+            format.channels,
+            format.latency * 1000);
+    return source;
+}
+
+std::unique_ptr<AudioSource> openSource(const SourceOptions &options)
+{
+    if (options.device.compare(0, GENERATOR_PREFIX.size(), GENERATOR_PREFIX) == 0) {
+        Generator::Params params;
+        if (!Generator::parse(options.device.substr(GENERATOR_PREFIX.size()), &params)) {
+            return nullptr;
+        }
+        return tryOpen(std::make_unique<GeneratorSource>(params));
+    }
+
+    if (!options.file.empty()) {
+        return tryOpen(std::make_unique<sdl::FileSource>(options.file, options.device, !options.offline));
+    }
+
+    if (options.offline) {
+        SDL_Log("Only files and test signals can be rendered offline");
+        return nullptr;
+    }
+
+    if (options.eventLoop) {
+        return tryOpen(std::make_unique<pulse::MonitorSource>(options.device));
+    }
+
+    if (auto source = tryOpen(std::make_unique<sdl::CaptureSource>(options.device))) {
+        return source;
+    }
+
+    SDL_Log("Not an SDL audio device, trying PulseAudio");
+    return tryOpen(std::make_unique<pulse::MonitorSource>(options.device));
+}
+
+}
+}
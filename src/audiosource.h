@@ -0,0 +1,99 @@
+#ifndef AUDIOSOURCE_H
+#define AUDIOSOURCE_H
+
+#include "samplebuffer.h"
+
+#include <memory>
+#include <string>
+
+namespace groggle
+{
+
+class EventLoop;
+
+namespace audio
+{
+
+/**
+ * What a source delivers once it is open. Samples are always s16, interleaved.
+ */
+struct Format
+{
+    int rate = 0; // Hz
+    int channels = 0;
+    float latency = 0; // s, size of one delivered chunk
+    float duration = 0; // s, 0 means endless
+};
+
+/**
+ * Common interface of everything that produces audio for the analysis.
+ *
+ * Contract: open() determines the format and allocates the sample buffer,
+ * run() then pushes incoming audio into that buffer until the stream ends or
+ * stop() is called. stop() may be called from any thread.
+ */
+class AudioSource
+{
+public:
+    virtual ~AudioSource() {}
+
+    virtual bool open() = 0;
+    virtual int run() = 0;
+    virtual void stop() = 0;
+    virtual std::string name() const = 0;
+
+    /**
+     * Pull interface for rendering faster than real time. Copies the next
+     * frames into dst instead of pushing them into the buffer.
+     * @return The number of frames read, 0 at the end or if the source can
+     * only deliver in real time.
+     */
+    virtual size_t read(int16_t /*dst*/[], const size_t /*frameCount*/) { return 0; }
+
+    /**
+     * Makes run() serve the event loop's descriptors as well, so everything
+     * runs on one thread. Must be called after open().
+     * @return false if the backend has no main loop of its own to share
+     */
+    virtual bool attach(EventLoop &/*loop*/) { return false; }
+
+    const Format &format() const { return m_format; }
+    std::shared_ptr<SampleBuffer> buffer() const { return m_buffer; }
+
+    /**
+     * Whether run() delivers the audio on the calling thread, which may then
+     * get a capture thread policy. Backends like SDL deliver from the
+     * library's own threads, those are left alone.
+     */
+    virtual bool deliversFromRun() const { return true; }
+
+protected:
+    /// To be called by implementations from open() once the format is known.
+    void setFormat(const Format &format);
+    void deliver(const int16_t samples[], const size_t frameCount);
+
+private:
+    Format m_format;
+    std::shared_ptr<SampleBuffer> m_buffer;
+};
+
+struct SourceOptions
+{
+    // Capture device, or output device for file playback. "gen:<spec>" selects
+    // the test signal generator, c.f. Generator::parse().
+    std::string device;
+    std::string file; // Audio file to play, device input is used if empty
+    bool offline = false; // Only read() will be used, no playback
+    bool eventLoop = false; // Only backends supporting attach()
+};
+
+/**
+ * Picks and opens the source matching the options.
+ * @return nullptr if no backend could be opened
+ */
+std::unique_ptr<AudioSource> openSource(const SourceOptions &options);
+
+}
+}
+
+#endif
@@ -0,0 +1,41 @@
+#include "changefilter.h"
+
+#include <cstring>
+
+namespace groggle
+{
+
+ChangeFilter::ChangeFilter(const uint64_t keepalive)
+    : m_keepalive(keepalive)
+{}
+
+bool ChangeFilter::apply(const DmxFrame &frame, const uint64_t now, DmxFrame *changed)
+{
+    changed->universes.clear();
+    changed->channels.clear();
+
+    for (size_t i = 0; i < frame.universes.size(); i++) {
+        const uint8_t *channels = frame.data(i);
+        Universe &last = m_universes[frame.universes[i]];
+        const bool fresh = last.channels.empty();
+        if (!fresh && m_keepalive > 0 && now - last.sentAt < m_keepalive
+                && memcmp(last.channels.data(), channels, UNIVERSE_SIZE) == 0) {
+            m_skipped++;
+            continue;
+        }
+
+        if (fresh) {
+            last.channels.resize(UNIVERSE_SIZE);
+        }
+        memcpy(last.channels.data(), channels, UNIVERSE_SIZE);
+        last.sentAt = now;
+        m_sent++;
+
+        changed->universes.push_back(frame.universes[i]);
+        changed->channels.insert(changed->channels.end(), channels, channels + UNIVERSE_SIZE);
+    }
+
+    return !changed->universes.empty();
+}
+
+}
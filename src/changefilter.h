@@ -0,0 +1,50 @@
+#ifndef CHANGEFILTER_H
+#define CHANGEFILTER_H
+
+#include "patch.h"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace groggle
+{
+
+/**
+ * Drops universes from frames that are the same as last time they were sent,
+ * unless the keepalive interval passed since. Receivers keep their last
+ * values, but some (sACN, Art-Net nodes) give up on a silent source after a
+ * few seconds.
+ */
+class ChangeFilter
+{
+public:
+    /// @param keepalive ns after which unchanged universes are sent again, 0 sends every frame
+    ChangeFilter(const uint64_t keepalive);
+
+    /**
+     * @param now ns, any monotonic clock
+     * @param changed Receives the universes that need sending
+     * @return false if none do
+     */
+    bool apply(const DmxFrame &frame, const uint64_t now, DmxFrame *changed);
+
+    uint64_t sent() const { return m_sent; }
+    uint64_t skipped() const { return m_skipped; }
+
+private:
+    struct Universe
+    {
+        std::vector<uint8_t> channels; // As last sent
+        uint64_t sentAt = 0;
+    };
+
+    const uint64_t m_keepalive;
+    std::map<uint16_t, Universe> m_universes;
+    uint64_t m_sent = 0; // Universes
+    uint64_t m_skipped = 0;
+};
+
+}
+
+#endif
@@ -1,10 +1,145 @@
 #include "color.h"
 
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <cstring>
 
 using namespace groggle;
 
+typedef float Lanes __attribute__((vector_size(16)));
+static const size_t LANES = 4;
+static const size_t HUE_STEPS = 3600;
+
+// HSV to RGB without branches, so it vectorizes: each component is
+// v - v s clamp(min(k, 4 - k), 0, 1) with k = (n + h / 60) mod 6, n being 5
+// for red, 3 for green and 1 for blue.
+// Source: https://en.wikipedia.org/wiki/HSL_and_HSV#HSV_to_RGB_alternative
+
+static inline float component(const float n, const float h, const float s, const float v)
+{
+    float k = n + h / 60;
+    k = k >= 6 ? k - 6 : k;
+    return v - v * s * std::min(std::max(std::min(k, 4 - k), 0.0f), 1.0f);
+}
+
+static inline Lanes component(const float n, const Lanes h, const Lanes s, const Lanes v)
+{
+    const Lanes zero = {};
+    const Lanes one = zero + 1;
+    Lanes k = n + h / 60;
+    k = k >= 6 ? k - 6 : k;
+    Lanes x = k < 4 - k ? k : 4 - k;
+    x = x < zero ? zero : x > one ? one : x;
+    return v - v * s * x;
+}
+
+static inline Lanes load(const float *p)
+{
+    Lanes lanes;
+    memcpy(&lanes, p, sizeof(lanes));
+    return lanes;
+}
+
+static inline void store(float *p, const Lanes lanes)
+{
+    memcpy(p, &lanes, sizeof(lanes));
+}
+
+void groggle::hsvToRgb(const float h[], const float s[], const float v[], float r[], float g[], float b[],
+                       const size_t count)
+{
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        const Lanes hue = load(&h[i]);
+        const Lanes saturation = load(&s[i]);
+        const Lanes value = load(&v[i]);
+        store(&r[i], component(5, hue, saturation, value));
+        store(&g[i], component(3, hue, saturation, value));
+        store(&b[i], component(1, hue, saturation, value));
+    }
+
+    for (; i < count; i++) {
+        const float hue = h[i];
+        const float saturation = s[i];
+        const float value = v[i];
+        r[i] = component(5, hue, saturation, value);
+        g[i] = component(3, hue, saturation, value);
+        b[i] = component(1, hue, saturation, value);
+    }
+}
+
+void groggle::rgbToHsv(const float r[], const float g[], const float b[], float h[], float s[], float v[],
+                       const size_t count)
+{
+    const Lanes zero = {};
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        const Lanes red = load(&r[i]);
+        const Lanes green = load(&g[i]);
+        const Lanes blue = load(&b[i]);
+        Lanes max = red > green ? red : green;
+        max = max > blue ? max : blue;
+        Lanes min = red < green ? red : green;
+        min = min < blue ? min : blue;
+        const Lanes delta = max - min;
+        // Lanes that would divide by zero get thrown away below
+        const Lanes divisor = delta > 0 ? delta : delta + 1;
+        const Lanes maxDivisor = max > 0 ? max : max + 1;
+
+        Lanes hue = max == red ? (green - blue) / divisor
+            : max == green ? (blue - red) / divisor + 2
+            : (red - green) / divisor + 4;
+        hue = delta > 0 ? hue * 60 : zero;
+        hue = hue < 0 ? hue + 360 : hue;
+
+        store(&h[i], hue);
+        store(&s[i], max > 0 ? delta / maxDivisor : zero);
+        store(&v[i], max);
+    }
+
+    for (; i < count; i++) {
+        const float max = std::max(r[i], std::max(g[i], b[i]));
+        const float delta = max - std::min(r[i], std::min(g[i], b[i]));
+        float hue = 0;
+        if (delta > 0) {
+            hue = max == r[i] ? (g[i] - b[i]) / delta
+                : max == g[i] ? (b[i] - r[i]) / delta + 2
+                : (r[i] - g[i]) / delta + 4;
+            hue *= 60;
+        }
+        h[i] = hue < 0 ? hue + 360 : hue;
+        s[i] = max > 0 ? delta / max : 0;
+        v[i] = max;
+    }
+}
+
+void groggle::hsvToRgbTable(const float h[], const float s[], const float v[], float r[], float g[], float b[],
+                            const size_t count)
+{
+    // Fully saturated colors at full value, the rest is scaling
+    static const std::array<float, 3 * HUE_STEPS> table = []() {
+        std::array<float, 3 * HUE_STEPS> table;
+        for (size_t i = 0; i < HUE_STEPS; i++) {
+            const float hue = i * 360.0f / HUE_STEPS;
+            table[3 * i] = component(5, hue, 1, 1);
+            table[3 * i + 1] = component(3, hue, 1, 1);
+            table[3 * i + 2] = component(1, hue, 1, 1);
+        }
+        return table;
+    }();
+
+    for (size_t i = 0; i < count; i++) {
+        const size_t index = static_cast<size_t>(h[i] * (HUE_STEPS / 360.0f) + 0.5f) % HUE_STEPS;
+        const float *pure = &table[3 * index];
+        const float gray = 1 - s[i];
+        const float value = v[i];
+        r[i] = value * (gray + s[i] * pure[0]);
+        g[i] = value * (gray + s[i] * pure[1]);
+        b[i] = value * (gray + s[i] * pure[2]);
+    }
+}
+
 Color::Color(const float h, const float s, const float v)
 {
     assert(h >= 0 && h < 360);
@@ -17,61 +152,9 @@ Color::Color(const float h, const float s, const float v)
     toRgb();
 }
 
-Color::Color(const Color &other)
-{
-    m_h = other.h();
-    m_s = other.s();
-    m_v = other.v();
-    toRgb();
-}
-
 void Color::toRgb()
 {
-    // Source: https://de.wikipedia.org/wiki/HSV-Farbraum#Umrechnung_HSV_in_RGB
-    if (m_s == 0) {
-        m_r = m_v;
-        m_g = m_v;
-        m_b = m_v;
-        return;
-    }
-
-    const int hi = std::floor(m_h / 60.0);
-    const float f = m_h / 60.0 - hi;
-    const float p = m_v * (1.0 - m_s);
-    const float q = m_v * (1.0 - m_s * f);
-    const float t = m_v * (1.0 - m_s * (1.0 - f));
-
-    switch(hi) {
-    case 0:
-    case 6:
-        m_r = m_v;
-        m_g = t;
-        m_b = p;
-        break;
-    case 1:
-        m_r = q;
-        m_g = m_v;
-        m_b = p;
-        break;
-    case 2:
-        m_r = p;
-        m_g = m_v;
-        m_b = t;
-        break;
-    case 3:
-        m_r = p;
-        m_g = q;
-        m_b = m_v;
-        break;
-    case 4:
-        m_r = t;
-        m_g = p;
-        m_b = m_v;
-        break;
-    case 5:
-        m_r = m_v;
-        m_g = p;
-        m_b = q;
-        break;
-    }
+    m_r = component(5, m_h, m_s, m_v);
+    m_g = component(3, m_h, m_s, m_v);
+    m_b = component(1, m_h, m_s, m_v);
 }
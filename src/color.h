@@ -3,11 +3,28 @@
 
 #include <algorithm> // min, max
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 
 namespace groggle
 {
 
+/**
+ * Batch conversions over arrays of colors, one array per component, 4 colors
+ * per instruction. Hue in degrees [0, 360), everything else 0-1. Results may
+ * overwrite the inputs.
+ */
+void hsvToRgb(const float h[], const float s[], const float v[], float r[], float g[], float b[], const size_t count);
+void rgbToHsv(const float r[], const float g[], const float b[], float h[], float s[], float v[], const size_t count);
+
+/// hsvToRgb() from a table of hues 0.1° apart, for when that is close enough.
+void hsvToRgbTable(const float h[], const float s[], const float v[], float r[], float g[], float b[],
+                   const size_t count);
+
+/**
+ * A HSV color that keeps its RGB form, computed when it changes and copied
+ * along with it.
+ */
 class Color
 {
 public:
@@ -18,7 +35,6 @@ public:
 
     Color(): Color(0, 0, 0) {}
     Color(const float h, const float s, const float v);
-    Color(const Color &other);
 
     bool operator==(const Color &other) {
         return m_h == other.h()
@@ -0,0 +1,108 @@
+#include "colorfade.h"
+
+#include <algorithm> // copy, min, max
+#include <cmath>
+
+namespace groggle
+{
+
+// Below this chroma the hue is meaningless, grays take the other end's hue
+static const float GRAY_CHROMA = 0.01f;
+
+void rgbToOklab(const float rgb[3], float lab[3])
+{
+    const float l = std::cbrt(0.4122214708f * rgb[0] + 0.5363325363f * rgb[1] + 0.0514459929f * rgb[2]);
+    const float m = std::cbrt(0.2119034982f * rgb[0] + 0.6806995451f * rgb[1] + 0.1073969566f * rgb[2]);
+    const float s = std::cbrt(0.0883024619f * rgb[0] + 0.2817188376f * rgb[1] + 0.6299787005f * rgb[2]);
+
+    lab[0] = 0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s;
+    lab[1] = 1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s;
+    lab[2] = 0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s;
+}
+
+void oklabToRgb(const float lab[3], float rgb[3])
+{
+    const float l = lab[0] + 0.3963377774f * lab[1] + 0.2158037573f * lab[2];
+    const float m = lab[0] - 0.1055613458f * lab[1] - 0.0638541728f * lab[2];
+    const float s = lab[0] - 0.0894841775f * lab[1] - 1.2914855480f * lab[2];
+    const float l3 = l * l * l;
+    const float m3 = m * m * m;
+    const float s3 = s * s * s;
+
+    rgb[0] = 4.0767416621f * l3 - 3.3077115913f * m3 + 0.2309699292f * s3;
+    rgb[1] = -1.2684380046f * l3 + 2.6097574011f * m3 - 0.3413193965f * s3;
+    rgb[2] = -0.0041960863f * l3 - 0.7034186147f * m3 + 1.7076147010f * s3;
+}
+
+ColorFade::ColorFade()
+{
+    m_path.fill(0);
+}
+
+void ColorFade::start(const float from[3], const float to[3], const float duration)
+{
+    float a[3];
+    float b[3];
+    rgbToOklab(from, a);
+    rgbToOklab(to, b);
+
+    // To lightness, chroma and hue
+    const float chromaA = std::hypot(a[1], a[2]);
+    const float chromaB = std::hypot(b[1], b[2]);
+    float hueA = std::atan2(a[2], a[1]);
+    float hueB = std::atan2(b[2], b[1]);
+    if (chromaA < GRAY_CHROMA) {
+        hueA = hueB;
+    } else if (chromaB < GRAY_CHROMA) {
+        hueB = hueA;
+    }
+    float turn = hueB - hueA;
+    if (turn > static_cast<float>(M_PI)) {
+        turn -= 2 * static_cast<float>(M_PI);
+    } else if (turn < -static_cast<float>(M_PI)) {
+        turn += 2 * static_cast<float>(M_PI);
+    }
+
+    for (size_t i = 0; i <= STEPS; i++) {
+        // Smoothstep, slow at both ends
+        const float x = i / static_cast<float>(STEPS);
+        const float t = x * x * (3 - 2 * x);
+
+        const float chroma = chromaA + (chromaB - chromaA) * t;
+        const float hue = hueA + turn * t;
+        const float lab[3] = { a[0] + (b[0] - a[0]) * t, chroma * std::cos(hue), chroma * std::sin(hue) };
+        float rgb[3];
+        oklabToRgb(lab, rgb);
+        for (size_t c = 0; c < 3; c++) {
+            m_path[3 * i + c] = std::min(std::max(rgb[c], 0.0f), 1.0f);
+        }
+    }
+
+    // The ends are exact, not round tripped
+    std::copy(from, from + 3, m_path.begin());
+    std::copy(to, to + 3, m_path.end() - 3);
+
+    m_progress = duration > 0 ? 0 : 1;
+    m_rate = duration > 0 ? 1 / duration : 0;
+}
+
+void ColorFade::advance(const float dt, float rgb[3])
+{
+    m_progress = std::min(m_progress + dt * m_rate, 1.0f);
+    sample(&m_progress, &rgb[0], &rgb[1], &rgb[2], 1);
+}
+
+void ColorFade::sample(const float progress[], float r[], float g[], float b[], const size_t count) const
+{
+    for (size_t i = 0; i < count; i++) {
+        const float position = std::min(std::max(progress[i], 0.0f), 1.0f) * STEPS;
+        const size_t step = std::min(static_cast<size_t>(position), STEPS - 1);
+        const float f = position - step;
+        const float *p = &m_path[3 * step];
+        r[i] = p[0] + (p[3] - p[0]) * f;
+        g[i] = p[1] + (p[4] - p[1]) * f;
+        b[i] = p[2] + (p[5] - p[2]) * f;
+    }
+}
+
+}
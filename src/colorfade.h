@@ -0,0 +1,53 @@
+#ifndef COLORFADE_H
+#define COLORFADE_H
+
+#include <array>
+#include <cstddef>
+
+namespace groggle
+{
+
+/**
+ * OKLab, a perceptually uniform color space: L is lightness 0-1, a and b are
+ * green-red and blue-yellow. RGB is linear, as DMX levels are.
+ * Source: https://bottosson.github.io/posts/oklab/
+ */
+void rgbToOklab(const float rgb[3], float lab[3]);
+void oklabToRgb(const float lab[3], float rgb[3]);
+
+/**
+ * A timed transition between two colors. It goes through OKLCh (OKLab in
+ * polar form) so lightness and saturation change evenly and the hue takes the
+ * shorter way round, and eases in and out.
+ *
+ * All color math happens in start(), which bakes the whole path into a table.
+ * Per frame it is one lookup and a linear blend, for one color or many.
+ */
+class ColorFade
+{
+public:
+    static const size_t STEPS = 256;
+
+    /// Done, at black.
+    ColorFade();
+
+    /// @param duration s, 0 jumps right to the new color
+    void start(const float from[3], const float to[3], const float duration);
+
+    bool isDone() const { return m_progress >= 1; }
+
+    /// Moves on by dt s and gives the color there.
+    void advance(const float dt, float rgb[3]);
+
+    /// Colors along the path, for progresses 0-1. Does not move on.
+    void sample(const float progress[], float r[], float g[], float b[], const size_t count) const;
+
+private:
+    std::array<float, 3 * (STEPS + 1)> m_path; // RGB per step
+    float m_progress = 1;
+    float m_rate = 0; // Progress per s
+};
+
+}
+
+#endif
@@ -0,0 +1,357 @@
+#include "cuefile.h"
+
+#include <SDL_log.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm> // min
+#include <cerrno>
+#include <cstring>
+
+namespace groggle
+{
+namespace cue
+{
+
+enum RecordType : uint8_t {
+    KEY = 0,
+    DELTA = 1
+};
+
+static const size_t HEADER_SIZE = 36;
+static const size_t RUN_HEADER_SIZE = 4;
+static const size_t INDEX_ENTRY_SIZE = 16;
+
+// The host is assumed to be little endian, as are x86 and the ARM boards we
+// run on. Going through memcpy keeps unaligned access legal.
+template <typename T>
+static void put(std::vector<uint8_t> &dst, const T value)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    dst.insert(dst.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+static T get(const uint8_t *src)
+{
+    T value;
+    memcpy(&value, src, sizeof(T));
+    return value;
+}
+
+// Writer
+// ======
+
+Writer::Writer(const std::string &path, const uint64_t syncInterval, const size_t bufferSize)
+    : m_buffer(bufferSize)
+    , m_syncInterval(syncInterval)
+{
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file) {
+        SDL_Log("Cannot open \"%s\" for writing: %s", path.c_str(), strerror(errno));
+        return;
+    }
+    if (bufferSize > 0) {
+        setvbuf(m_file, m_buffer.data(), _IOFBF, m_buffer.size());
+    }
+
+    // Placeholder, the real one is written by close()
+    const uint8_t header[HEADER_SIZE] = {};
+    fwrite(header, sizeof(header), 1, m_file);
+    m_offset = HEADER_SIZE;
+}
+
+Writer::~Writer()
+{
+    close();
+}
+
+bool Writer::write(const uint64_t timestamp, const uint16_t universe, const uint8_t channels[], const size_t length)
+{
+    if (!m_file) {
+        return false;
+    }
+
+    if (timestamp < m_lastTimestamp) {
+        SDL_Log("Cue frames must be written in order");
+        return false;
+    }
+    m_lastTimestamp = timestamp;
+
+    uint8_t current[UNIVERSE_SIZE] = {};
+    memcpy(current, channels, std::min(length, UNIVERSE_SIZE));
+
+    // Sync point: snapshot every other universe, this one follows below
+    bool key = false;
+    if (m_index.empty() || timestamp >= m_index.back().first + m_syncInterval) {
+        m_index.push_back({ timestamp, m_offset });
+        for (const auto &it : m_universes) {
+            if (it.first != universe && !writeKey(timestamp, it.first, it.second.data())) {
+                return false;
+            }
+        }
+        key = true;
+    }
+
+    std::vector<uint8_t> &previous = m_universes[universe];
+    if (previous.empty()) {
+        previous.resize(UNIVERSE_SIZE, 0);
+        key = true;
+    }
+
+    if (!key) {
+        // Runs of changed channels. Unchanged gaps shorter than a run header
+        // are cheaper to repeat than to start a new run.
+        m_record.clear();
+        put<uint64_t>(m_record, timestamp);
+        put<uint16_t>(m_record, universe);
+        put<uint8_t>(m_record, DELTA);
+        put<uint16_t>(m_record, 0); // Run count, patched below
+
+        uint16_t runs = 0;
+        size_t i = 0;
+        while (i < UNIVERSE_SIZE) {
+            if (current[i] == previous[i]) {
+                i++;
+                continue;
+            }
+
+            size_t lastChanged = i;
+            for (size_t j = i + 1; j < UNIVERSE_SIZE && j - lastChanged <= RUN_HEADER_SIZE; j++) {
+                if (current[j] != previous[j]) {
+                    lastChanged = j;
+                }
+            }
+
+            const uint16_t count = lastChanged - i + 1;
+            put<uint16_t>(m_record, i);
+            put<uint16_t>(m_record, count);
+            m_record.insert(m_record.end(), &current[i], &current[i] + count);
+            runs++;
+            i = lastChanged + 1;
+        }
+        memcpy(&m_record[RECORD_HEADER_SIZE - sizeof(uint16_t)], &runs, sizeof(runs));
+
+        size_t keySize = UNIVERSE_SIZE;
+        while (keySize > 0 && current[keySize - 1] == 0) {
+            keySize--;
+        }
+        key = m_record.size() >= RECORD_HEADER_SIZE + keySize;
+
+        if (!key) {
+            memcpy(previous.data(), current, UNIVERSE_SIZE);
+            return writeRecord(m_record);
+        }
+    }
+
+    memcpy(previous.data(), current, UNIVERSE_SIZE);
+    return writeKey(timestamp, universe, current);
+}
+
+bool Writer::writeKey(const uint64_t timestamp, const uint16_t universe, const uint8_t channels[])
+{
+    uint16_t length = UNIVERSE_SIZE;
+    while (length > 0 && channels[length - 1] == 0) {
+        length--;
+    }
+
+    m_record.clear();
+    put<uint64_t>(m_record, timestamp);
+    put<uint16_t>(m_record, universe);
+    put<uint8_t>(m_record, KEY);
+    put<uint16_t>(m_record, length);
+    m_record.insert(m_record.end(), channels, channels + length);
+    return writeRecord(m_record);
+}
+
+bool Writer::writeRecord(const std::vector<uint8_t> &record)
+{
+    if (fwrite(record.data(), 1, record.size(), m_file) != record.size()) {
+        SDL_Log("Writing cue frame failed: %s", strerror(errno));
+        return false;
+    }
+
+    m_offset += record.size();
+    m_frameCount++;
+    return true;
+}
+
+bool Writer::close()
+{
+    if (!m_file) {
+        return true;
+    }
+
+    m_record.clear();
+    for (const auto &entry : m_index) {
+        put<uint64_t>(m_record, entry.first);
+        put<uint64_t>(m_record, entry.second);
+    }
+    bool ok = fwrite(m_record.data(), 1, m_record.size(), m_file) == m_record.size();
+
+    m_record.clear();
+    m_record.insert(m_record.end(), MAGIC, MAGIC + sizeof(MAGIC));
+    put<uint32_t>(m_record, VERSION);
+    put<uint32_t>(m_record, m_frameCount);
+    put<uint32_t>(m_record, m_index.size());
+    put<uint64_t>(m_record, m_offset);
+    put<uint64_t>(m_record, m_lastTimestamp);
+    ok = ok && fseek(m_file, 0, SEEK_SET) == 0
+        && fwrite(m_record.data(), 1, m_record.size(), m_file) == m_record.size();
+
+    ok = fclose(m_file) == 0 && ok;
+    m_file = nullptr;
+    return ok;
+}
+
+// Reader
+// ======
+
+Reader::Reader(const std::string &path)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        SDL_Log("Cannot open \"%s\": %s", path.c_str(), strerror(errno));
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < HEADER_SIZE) {
+        SDL_Log("\"%s\" is not a cue file", path.c_str());
+        ::close(fd);
+        return;
+    }
+
+    void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping stays valid
+    if (data == MAP_FAILED) {
+        SDL_Log("Cannot map \"%s\": %s", path.c_str(), strerror(errno));
+        return;
+    }
+
+    m_data = reinterpret_cast<const uint8_t *>(data);
+    m_size = info.st_size;
+    madvise(data, m_size, MADV_SEQUENTIAL);
+
+    const uint32_t version = get<uint32_t>(&m_data[8]);
+    m_frameCount = get<uint32_t>(&m_data[12]);
+    m_indexCount = get<uint32_t>(&m_data[16]);
+    m_indexOffset = get<uint64_t>(&m_data[20]);
+    m_duration = get<uint64_t>(&m_data[28]);
+
+    if (memcmp(m_data, MAGIC, sizeof(MAGIC)) != 0
+        || version != VERSION
+        || m_indexOffset < HEADER_SIZE
+        || m_indexOffset > m_size
+        || (m_size - m_indexOffset) / INDEX_ENTRY_SIZE < m_indexCount) {
+        SDL_Log("\"%s\" is not a version %u cue file", path.c_str(), VERSION);
+        munmap(data, m_size);
+        m_data = nullptr;
+        return;
+    }
+
+    m_offset = HEADER_SIZE;
+}
+
+Reader::~Reader()
+{
+    if (m_data) {
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+    }
+}
+
+void Reader::seek(const uint64_t timestamp)
+{
+    if (!m_data) {
+        return;
+    }
+
+    // Last sync point at or before timestamp
+    const uint8_t *index = &m_data[m_indexOffset];
+    uint32_t lo = 0;
+    uint32_t hi = m_indexCount;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (get<uint64_t>(&index[mid * INDEX_ENTRY_SIZE]) <= timestamp) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    m_universes.clear();
+    m_offset = lo > 0 ? get<uint64_t>(&index[(lo - 1) * INDEX_ENTRY_SIZE + 8]) : HEADER_SIZE;
+
+    // Replay up to the target, without handing out the frames
+    Frame frame;
+    while (m_offset + RECORD_HEADER_SIZE <= m_indexOffset
+           && get<uint64_t>(&m_data[m_offset]) < timestamp
+           && decode(&frame)) {
+    }
+}
+
+bool Reader::next(Frame *frame)
+{
+    return m_data && decode(frame);
+}
+
+bool Reader::decode(Frame *frame)
+{
+    if (m_offset + RECORD_HEADER_SIZE > m_indexOffset) {
+        return false;
+    }
+
+    const uint8_t *record = &m_data[m_offset];
+    const uint8_t *end = &m_data[m_indexOffset];
+    frame->timestamp = get<uint64_t>(record);
+    frame->universe = get<uint16_t>(&record[8]);
+    const uint8_t type = record[10];
+    const uint16_t length = get<uint16_t>(&record[11]);
+    const uint8_t *pos = &record[RECORD_HEADER_SIZE];
+
+    std::vector<uint8_t> &channels = m_universes[frame->universe];
+    channels.resize(UNIVERSE_SIZE, 0);
+
+    switch (type) {
+    case KEY:
+        if (length > UNIVERSE_SIZE || pos + length > end) {
+            SDL_Log("Corrupt cue frame at %lu", static_cast<unsigned long>(m_offset));
+            return false;
+        }
+        memcpy(channels.data(), pos, length);
+        memset(&channels[length], 0, UNIVERSE_SIZE - length);
+        pos += length;
+        break;
+    case DELTA:
+        for (uint16_t run = 0; run < length; run++) {
+            if (pos + RUN_HEADER_SIZE > end) {
+                SDL_Log("Corrupt cue frame at %lu", static_cast<unsigned long>(m_offset));
+                return false;
+            }
+
+            const uint16_t offset = get<uint16_t>(pos);
+            const uint16_t count = get<uint16_t>(&pos[2]);
+            pos += RUN_HEADER_SIZE;
+            if (offset + count > static_cast<int>(UNIVERSE_SIZE) || pos + count > end) {
+                SDL_Log("Corrupt cue frame at %lu", static_cast<unsigned long>(m_offset));
+                return false;
+            }
+            memcpy(&channels[offset], pos, count);
+            pos += count;
+        }
+        break;
+    default:
+        SDL_Log("Unknown cue frame type %i", type);
+        return false;
+    }
+
+    frame->channels = channels.data();
+    m_offset = pos - m_data;
+    return true;
+}
+
+}
+}
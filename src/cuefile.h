@@ -0,0 +1,125 @@
+#ifndef CUEFILE_H
+#define CUEFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace groggle
+{
+
+/**
+ * Pre-rendered light shows.
+ *
+ * Layout, all integers little endian, no padding:
+ *   Header: char magic[8] = "GRGLCUE\0", uint32 version, uint32 frameCount,
+ *           uint32 indexCount, uint64 indexOffset, uint64 duration (ns)
+ *   Records: uint64 timestamp (ns), uint16 universe, uint8 type, uint16 length
+ *     KEY:   uint8 channels[length], trailing zero channels are not stored
+ *     DELTA: length runs of { uint16 offset, uint16 count, uint8 channels[count] }
+ *            against the previous frame of the same universe
+ *   Index: indexCount entries of { uint64 timestamp, uint64 offset }
+ *
+ * Every index entry points to a sync point, a set of KEY records for all
+ * universes known at that time. Seeking only has to decode from the last
+ * sync point before the target.
+ */
+namespace cue
+{
+
+static const char MAGIC[8] = { 'G', 'R', 'G', 'L', 'C', 'U', 'E', '\0' };
+static const uint32_t VERSION = 2;
+static const size_t UNIVERSE_SIZE = 512;
+static const size_t RECORD_HEADER_SIZE = 13;
+static const size_t MAX_RECORD_SIZE = RECORD_HEADER_SIZE + UNIVERSE_SIZE; // KEY of a full universe
+
+struct Frame
+{
+    uint64_t timestamp = 0; // ns since the start of the show
+    uint16_t universe = 0;
+    const uint8_t *channels = nullptr; // UNIVERSE_SIZE, valid until the next call
+};
+
+class Writer
+{
+public:
+    /**
+     * @param syncInterval Time between sync points in ns. Shorter means
+     * faster seeking but a bigger file.
+     * @param bufferSize Bytes collected before each write to the file, 0 for
+     * the stdio default
+     */
+    Writer(const std::string &path, const uint64_t syncInterval = 1000 * 1000 * 1000, const size_t bufferSize = 0);
+    ~Writer();
+
+    bool isOpen() const { return m_file != nullptr; }
+    uint32_t frameCount() const { return m_frameCount; }
+
+    /// Timestamps must not decrease.
+    bool write(const uint64_t timestamp, const uint16_t universe, const uint8_t channels[], const size_t length);
+
+    /// Writes index and header. Called by the destructor if necessary.
+    bool close();
+
+private:
+    Writer(const Writer&) = delete;
+    Writer &operator=(const Writer&) = delete;
+
+    bool writeKey(const uint64_t timestamp, const uint16_t universe, const uint8_t channels[]);
+    bool writeRecord(const std::vector<uint8_t> &record);
+
+    std::vector<char> m_buffer; // Outlives m_file
+    FILE *m_file = nullptr;
+    const uint64_t m_syncInterval;
+    uint64_t m_offset = 0;
+    uint64_t m_lastTimestamp = 0;
+    uint32_t m_frameCount = 0;
+    std::map<uint16_t, std::vector<uint8_t>> m_universes;
+    std::vector<std::pair<uint64_t, uint64_t>> m_index;
+    std::vector<uint8_t> m_record; // Recycled
+};
+
+/**
+ * Decodes a memory mapped cue file.
+ */
+class Reader
+{
+public:
+    Reader(const std::string &path);
+    ~Reader();
+
+    bool isOpen() const { return m_data != nullptr; }
+    uint32_t frameCount() const { return m_frameCount; }
+    uint64_t duration() const { return m_duration; }
+
+    /**
+     * Positions the reader so that next() returns the first frame at or
+     * after timestamp, with all universes in the state they had right before.
+     */
+    void seek(const uint64_t timestamp);
+
+    /// @return false at the end of the file or on errors
+    bool next(Frame *frame);
+
+private:
+    Reader(const Reader&) = delete;
+    Reader &operator=(const Reader&) = delete;
+
+    bool decode(Frame *frame);
+
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+    uint32_t m_frameCount = 0;
+    uint64_t m_duration = 0;
+    uint32_t m_indexCount = 0;
+    uint64_t m_indexOffset = 0;
+    uint64_t m_offset = 0; // Next record
+    std::map<uint16_t, std::vector<uint8_t>> m_universes;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,29 @@
+#include "cueplayer.h"
+
+#include <chrono>
+#include <thread>
+
+using std::chrono::steady_clock;
+
+namespace groggle
+{
+
+CuePlayer::CuePlayer(const std::string &path, std::shared_ptr<DmxSink> sink)
+    : m_reader(path)
+    , m_sink(sink)
+{}
+
+void CuePlayer::play(const uint64_t from)
+{
+    m_reader.seek(from);
+    const auto start = steady_clock::now();
+
+    cue::Frame frame;
+    while (m_running && m_reader.next(&frame)) {
+        std::this_thread::sleep_until(start + std::chrono::nanoseconds(frame.timestamp - from));
+        m_dmx.Set(frame.channels, cue::UNIVERSE_SIZE);
+        m_sink->send(frame.universe, m_dmx);
+    }
+}
+
+}
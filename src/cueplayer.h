@@ -0,0 +1,45 @@
+#ifndef CUEPLAYER_H
+#define CUEPLAYER_H
+
+#include "cuefile.h"
+#include "dmxsink.h"
+
+#include <ola/DmxBuffer.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace groggle
+{
+
+/**
+ * Sends a pre-rendered cue file to a sink at the recorded timestamps.
+ * Nothing is analyzed, so this costs next to no CPU.
+ */
+class CuePlayer
+{
+public:
+    CuePlayer(const std::string &path, std::shared_ptr<DmxSink> sink);
+
+    bool isOpen() const { return m_reader.isOpen(); }
+    uint64_t duration() const { return m_reader.duration(); }
+
+    /**
+     * Plays from the given show time (ns) until the end or until stop() is
+     * called. Blocks.
+     */
+    void play(const uint64_t from = 0);
+    /// Also before play() starts, which then returns right away.
+    void stop() { m_running = false; }
+
+private:
+    cue::Reader m_reader;
+    std::shared_ptr<DmxSink> m_sink;
+    ola::DmxBuffer m_dmx;
+    std::atomic<bool> m_running { true };
+};
+
+}
+
+#endif
@@ -0,0 +1,32 @@
+#include "cuesink.h"
+
+namespace groggle
+{
+
+CueSink::CueSink(const std::string &path, Clock clock, const size_t bufferSize)
+    : m_writer(path, 1000 * 1000 * 1000, bufferSize)
+    , m_clock(clock)
+{}
+
+bool CueSink::send(const unsigned int universe, const ola::DmxBuffer &dmx)
+{
+    return m_writer.write(m_clock(), universe, dmx.GetRaw(), dmx.Size());
+}
+
+bool CueSink::sendFrame(const DmxFrame &frame)
+{
+    // Straight from the frame, no DmxBuffer copies
+    const uint64_t timestamp = m_clock();
+    bool ok = true;
+    for (size_t i = 0; i < frame.universes.size(); i++) {
+        ok = m_writer.write(timestamp, frame.universes[i], frame.data(i), UNIVERSE_SIZE) && ok;
+    }
+    return ok;
+}
+
+bool CueSink::close()
+{
+    return m_writer.close();
+}
+
+}
@@ -0,0 +1,40 @@
+#ifndef CUESINK_H
+#define CUESINK_H
+
+#include "cuefile.h"
+#include "dmxsink.h"
+
+#include <functional>
+#include <string>
+
+namespace groggle
+{
+
+/**
+ * Records everything sent to it into a cue file. Timestamps come from the
+ * given clock, which need not be real time.
+ */
+class CueSink : public DmxSink
+{
+public:
+    typedef std::function<uint64_t()> Clock; // ns
+
+    /// @param bufferSize Bytes written to the file at a time, c.f. cue::Writer
+    CueSink(const std::string &path, Clock clock, const size_t bufferSize = 0);
+
+    bool isOpen() const { return m_writer.isOpen(); }
+    uint32_t frameCount() const { return m_writer.frameCount(); }
+
+    bool send(const unsigned int universe, const ola::DmxBuffer &dmx) override;
+    bool sendFrame(const DmxFrame &frame) override;
+    /// Writes the index, the file is only readable after this.
+    bool close() override;
+
+private:
+    cue::Writer m_writer;
+    Clock m_clock;
+};
+
+}
+
+#endif
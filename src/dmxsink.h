@@ -0,0 +1,46 @@
+#ifndef DMXSINK_H
+#define DMXSINK_H
+
+#include "patch.h"
+
+#include <ola/DmxBuffer.h>
+
+namespace groggle
+{
+
+/**
+ * Somewhere to send rendered DMX universes to.
+ */
+class DmxSink
+{
+public:
+    virtual ~DmxSink() {}
+
+    /// @return false if the frame could not be delivered
+    virtual bool send(const unsigned int universe, const ola::DmxBuffer &dmx) = 0;
+
+    /**
+     * Sends every universe of the frame once. Sinks that can batch several
+     * universes override this.
+     * @return false if any universe could not be delivered
+     */
+    virtual bool sendFrame(const DmxFrame &frame)
+    {
+        bool ok = true;
+        for (size_t i = 0; i < frame.universes.size(); i++) {
+            ok = send(frame.universes[i], ola::DmxBuffer(frame.data(i), UNIVERSE_SIZE)) && ok;
+        }
+        return ok;
+    }
+
+    /**
+     * Finishes the output after the last frame, e.g. writes a file's index.
+     * Nothing is delivered after this.
+     * @return false if finishing failed
+     */
+    virtual bool close() { return true; }
+};
+
+}
+
+#endif
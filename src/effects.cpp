@@ -0,0 +1,183 @@
+#include "effects.h"
+
+#include "patch.h"
+
+#include <algorithm> // fill, max, min
+#include <cmath>
+
+namespace groggle
+{
+
+static const char *TYPE_NAMES[] = { "band", "flash", "chase", "hue", "strobe" };
+
+Effect Effect::defaults(const Type type)
+{
+    Effect effect;
+    effect.type = type;
+    switch (type) {
+    case Type::BAND:
+        break;
+    case Type::FLASH:
+        effect.role = Role::BASS;
+        effect.length = 0.25f;
+        break;
+    case Type::CHASE:
+        effect.rate = 1;
+        break;
+    case Type::HUE:
+        effect.rate = 30;
+        break;
+    case Type::STROBE:
+        effect.role = Role::BASS;
+        effect.rate = 10;
+        effect.length = 0.5f;
+        break;
+    }
+    return effect;
+}
+
+bool Effect::parseType(const std::string &name, Type *type)
+{
+    for (size_t i = 0; i < sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]); i++) {
+        if (name == TYPE_NAMES[i]) {
+            *type = static_cast<Type>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+EffectEngine::EffectEngine(const Patch &patch)
+{
+    const std::vector<Patch::Fixture> &fixtures = patch.fixtures();
+
+    // Groups in the order they first appear, their fixtures in patch order
+    std::vector<std::string> groups;
+    for (const Patch::Fixture &fixture : fixtures) {
+        if (std::find(groups.begin(), groups.end(), fixture.group) == groups.end()) {
+            groups.push_back(fixture.group);
+        }
+    }
+
+    for (const std::string &group : groups) {
+        Instruction instruction;
+        instruction.first = m_fixture.size();
+        for (size_t i = 0; i < fixtures.size(); i++) {
+            if (fixtures[i].group == group) {
+                m_fixture.push_back(i);
+                m_role.push_back(static_cast<uint8_t>(fixtures[i].role));
+                m_mix.push_back(patch.profiles().at(fixtures[i].profile).mix());
+            }
+        }
+        instruction.count = m_fixture.size() - instruction.first;
+        for (uint32_t i = 0; i < instruction.count; i++) {
+            m_position.push_back(i / static_cast<float>(instruction.count));
+        }
+
+        // Without a chain, fixtures follow their role as they always did
+        const auto chain = patch.effects().find(group);
+        const std::vector<Effect> effects = chain == patch.effects().end()
+            ? std::vector<Effect> { Effect::defaults(Effect::Type::BAND) }
+            : chain->second;
+        for (const Effect &effect : effects) {
+            instruction.effect = effect;
+            instruction.state = m_state.size();
+            m_program.push_back(instruction);
+            m_state.push_back(0);
+        }
+    }
+
+    m_red.assign(m_fixture.size(), 0);
+    m_green.assign(m_fixture.size(), 0);
+    m_blue.assign(m_fixture.size(), 0);
+    m_dimmer.assign(m_fixture.size(), 0);
+}
+
+void EffectEngine::run(const EffectInputs &inputs, const float dt, uint16_t levels[])
+{
+    m_time += dt;
+
+    std::fill(m_red.begin(), m_red.end(), inputs.rgb[0]);
+    std::fill(m_green.begin(), m_green.end(), inputs.rgb[1]);
+    std::fill(m_blue.begin(), m_blue.end(), inputs.rgb[2]);
+    std::fill(m_dimmer.begin(), m_dimmer.end(), 1.0f);
+
+    for (const Instruction &instruction : m_program) {
+        execute(instruction, inputs, dt);
+    }
+
+    for (size_t i = 0; i < m_fixture.size(); i++) {
+        const float rgb[3] = { m_red[i], m_green[i], m_blue[i] };
+        level::compute(rgb, m_mix[i], m_dimmer[i] * inputs.brightness, &levels[m_fixture[i] * level::COUNT]);
+    }
+}
+
+void EffectEngine::execute(const Instruction &instruction, const EffectInputs &inputs, const float dt)
+{
+    const Effect &effect = instruction.effect;
+    const size_t first = instruction.first;
+    const size_t last = first + instruction.count;
+    float &state = m_state[instruction.state];
+    const bool onset = effect.role != Role::COUNT && inputs.onsets[static_cast<size_t>(effect.role)];
+
+    switch (effect.type) {
+    case Effect::Type::BAND:
+        for (size_t i = first; i < last; i++) {
+            const size_t role = effect.role == Role::COUNT ? m_role[i] : static_cast<size_t>(effect.role);
+            m_dimmer[i] *= 1 - effect.depth + effect.depth * inputs.bands[role];
+        }
+        break;
+
+    case Effect::Type::FLASH: {
+        state = onset ? 1.0f : std::max(state - dt / std::max(effect.length, dt), 0.0f);
+        for (size_t i = first; i < last; i++) {
+            m_dimmer[i] = std::max(m_dimmer[i], state * effect.depth);
+        }
+        break;
+    }
+
+    case Effect::Type::CHASE: {
+        // Distance to the spot in fixtures, around the end of the group
+        const float count = instruction.count;
+        const float spot = std::fmod(m_time * effect.rate, 1.0) * count;
+        for (size_t i = first; i < last; i++) {
+            float distance = std::fabs(m_position[i] * count - spot);
+            distance = std::min(distance, count - distance);
+            const float level = std::max(1 - distance / effect.width, 0.0f);
+            m_dimmer[i] *= 1 - effect.depth + effect.depth * level;
+        }
+        break;
+    }
+
+    case Effect::Type::HUE: {
+        // Rotation around the gray axis, no detour through HSV
+        const float base = std::fmod(m_time * effect.rate, 360.0);
+        for (size_t i = first; i < last; i++) {
+            const float angle = (base + effect.spread * m_position[i]) * static_cast<float>(M_PI) / 180;
+            const float c = std::cos(angle);
+            const float k = (1 - c) / 3;
+            const float q = std::sin(angle) / std::sqrt(3.0f);
+            const float r = m_red[i];
+            const float g = m_green[i];
+            const float b = m_blue[i];
+            m_red[i] = (c + k) * r + (k - q) * g + (k + q) * b;
+            m_green[i] = (k + q) * r + (c + k) * g + (k - q) * b;
+            m_blue[i] = (k - q) * r + (k + q) * g + (c + k) * b;
+        }
+        break;
+    }
+
+    case Effect::Type::STROBE: {
+        state = onset ? effect.length : std::max(state - dt, 0.0f);
+        if (state > 0) {
+            const bool on = std::fmod(m_time * effect.rate, 1.0) < 0.5;
+            for (size_t i = first; i < last; i++) {
+                m_dimmer[i] = on ? std::max(m_dimmer[i], effect.depth) : m_dimmer[i] * (1 - effect.depth);
+            }
+        }
+        break;
+    }
+    }
+}
+
+}
@@ -0,0 +1,110 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include "fixtures.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace groggle
+{
+
+class Patch;
+
+/**
+ * One step of a fixture group's effect chain. Every step works on each
+ * fixture's color and dimmer as left by the steps before it, starting from
+ * the show's color at full.
+ *
+ *   band    dims to the role's level, the fixture's own role by default
+ *   flash   jumps to full on an onset in the role, fading out over length
+ *   chase   a spot width fixtures wide runs through the group rate times per s
+ *   hue     rotates the hue by rate degrees per s, plus spread degrees
+ *           across the group
+ *   strobe  flashes rate times per s for length s after an onset
+ *
+ * depth scales how far band, chase and strobe pull the dimmer, 0-1.
+ */
+struct Effect
+{
+    enum class Type : uint8_t
+    {
+        BAND,
+        FLASH,
+        CHASE,
+        HUE,
+        STROBE
+    };
+
+    Type type = Type::BAND;
+    Role role = Role::COUNT; // COUNT for the fixture's own
+    float depth = 1;
+    float rate = 0;
+    float length = 0; // s
+    float width = 1; // Fixtures
+    float spread = 0; // Degrees
+
+    /// An effect of the type with usable parameters.
+    static Effect defaults(const Type type);
+    static bool parseType(const std::string &name, Type *type);
+};
+
+/// What the effects react to, once per frame.
+struct EffectInputs
+{
+    float rgb[3] = {}; // 0-1
+    float bands[ROLE_COUNT] = {}; // The roles' levels, 0-1
+    bool onsets[ROLE_COUNT] = {}; // Whether the role just jumped up
+    float brightness = 1; // Master level over all effects
+};
+
+/**
+ * Runs the patch's effect chains over all fixtures. The chains are compiled
+ * once into a flat list of instructions, each working on the contiguous run
+ * of its group's fixtures, so a frame is a handful of tight loops over
+ * preallocated arrays.
+ */
+class EffectEngine
+{
+public:
+    EffectEngine(const Patch &patch);
+
+    size_t instructionCount() const { return m_program.size(); }
+
+    /**
+     * @param dt s since the last frame
+     * @param levels level::COUNT values per patched fixture, in patch order
+     */
+    void run(const EffectInputs &inputs, const float dt, uint16_t levels[]);
+
+private:
+    struct Instruction
+    {
+        Effect effect;
+        uint32_t first = 0; // Slot
+        uint32_t count = 0;
+        uint32_t state = 0; // Index into m_state
+    };
+
+    void execute(const Instruction &instruction, const EffectInputs &inputs, const float dt);
+
+    std::vector<Instruction> m_program;
+    std::vector<float> m_state; // Flash and strobe envelopes
+    double m_time = 0; // s
+
+    // Per slot, fixtures sorted by group
+    std::vector<uint32_t> m_fixture; // Index in the patch
+    std::vector<uint8_t> m_role;
+    std::vector<uint8_t> m_mix;
+    std::vector<float> m_position; // 0-1 within the group
+    std::vector<float> m_red;
+    std::vector<float> m_green;
+    std::vector<float> m_blue;
+    std::vector<float> m_dimmer;
+};
+
+}
+
+#endif
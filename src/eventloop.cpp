@@ -0,0 +1,123 @@
+#include "eventloop.h"
+
+#include <SDL_log.h>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+namespace groggle
+{
+
+static const int MAX_EVENTS = 16;
+
+EventLoop::EventLoop()
+{
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll < 0) {
+        SDL_Log("epoll_create1 failed: %s", strerror(errno));
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    if (m_epoll >= 0) {
+        close(m_epoll);
+    }
+}
+
+bool EventLoop::add(const int fd, const uint32_t events, Handler handler)
+{
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+        SDL_Log("Cannot watch fd %i: %s", fd, strerror(errno));
+        return false;
+    }
+
+    m_handlers[fd] = handler;
+    return true;
+}
+
+bool EventLoop::modify(const int fd, const uint32_t events)
+{
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = fd;
+    return epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void EventLoop::remove(const int fd)
+{
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    m_handlers.erase(fd);
+}
+
+int EventLoop::addTimer(const float frequency, TimerHandler handler)
+{
+    const int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer < 0) {
+        SDL_Log("timerfd_create failed: %s", strerror(errno));
+        return -1;
+    }
+
+    const bool added = add(timer, EPOLLIN, [timer, handler](const uint32_t) {
+        uint64_t expirations = 0;
+        if (read(timer, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+            handler(expirations);
+        }
+    });
+
+    if (!added || !setTimerFrequency(timer, frequency)) {
+        removeTimer(timer);
+        return -1;
+    }
+    return timer;
+}
+
+bool EventLoop::setTimerFrequency(const int timer, const float frequency)
+{
+    const long long interval = round(1e9 / frequency);
+    itimerspec spec;
+    spec.it_interval.tv_sec = interval / 1000000000;
+    spec.it_interval.tv_nsec = interval % 1000000000;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(timer, 0, &spec, nullptr) != 0) {
+        SDL_Log("timerfd_settime failed: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::removeTimer(const int timer)
+{
+    remove(timer);
+    close(timer);
+}
+
+void EventLoop::dispatch(const int timeout)
+{
+    epoll_event events[MAX_EVENTS];
+    int count = 0;
+    do {
+        count = epoll_wait(m_epoll, events, MAX_EVENTS, timeout);
+    } while (count < 0 && errno == EINTR);
+
+    for (int i = 0; i < count; i++) {
+        // Copied, an earlier handler may have removed this one
+        const auto it = m_handlers.find(events[i].data.fd);
+        if (it != m_handlers.end()) {
+            const Handler handler = it->second;
+            handler(events[i].events);
+        }
+    }
+}
+
+}
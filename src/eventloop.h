@@ -0,0 +1,55 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+namespace groggle
+{
+
+/**
+ * An epoll set of file descriptors with callbacks. It does not loop by
+ * itself: whoever owns the thread (e.g. the PulseAudio mainloop) polls fd()
+ * along with its own descriptors and calls dispatch() when it is readable.
+ */
+class EventLoop
+{
+public:
+    typedef std::function<void(const uint32_t events)> Handler; // EPOLLIN etc.
+    typedef std::function<void(const uint64_t expirations)> TimerHandler;
+
+    EventLoop();
+    ~EventLoop();
+
+    bool isOpen() const { return m_epoll >= 0; }
+    int fd() const { return m_epoll; }
+
+    bool add(const int fd, const uint32_t events, Handler handler);
+    bool modify(const int fd, const uint32_t events);
+    /// Safe to call from handlers.
+    void remove(const int fd);
+
+    /**
+     * Adds a timerfd firing at the given rate.
+     * @return The timer's fd, -1 on failure
+     */
+    int addTimer(const float frequency, TimerHandler handler);
+    bool setTimerFrequency(const int timer, const float frequency);
+    /// Closes the timerfd as well.
+    void removeTimer(const int timer);
+
+    /// Calls the handlers of all ready descriptors, waiting at most timeout ms.
+    void dispatch(const int timeout = 0);
+
+private:
+    EventLoop(const EventLoop&) = delete;
+    EventLoop &operator=(const EventLoop&) = delete;
+
+    int m_epoll = -1;
+    std::unordered_map<int, Handler> m_handlers;
+};
+
+}
+
+#endif
@@ -0,0 +1,225 @@
+#include "fixtures.h"
+
+#include <SDL_log.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm> // find_if, min, max
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+using json = nlohmann::json;
+
+namespace groggle
+{
+
+static const char *BUILTIN_PROFILES = R"({ "profiles": [
+    { "name": "rgb", "channels": [ "red", "green", "blue" ] },
+    { "name": "rgbw", "channels": [ "red", "green", "blue", "white" ] },
+    { "name": "rgba", "channels": [ "red", "green", "blue", "amber" ] },
+    { "name": "rgb16", "channels": [ "red", "red fine", "green", "green fine", "blue", "blue fine" ] },
+    { "name": "dimmer", "channels": [ "dimmer" ] },
+    { "name": "dimmer16", "channels": [ "dimmer", "dimmer fine" ] },
+    { "name": "tripar", "channels": [ "red", "green", "blue", null, null, "dimmer" ] },
+    { "name": "movinghead", "channels": [ "pan", "pan fine", "tilt", "tilt fine", "dimmer", "red", "green", "blue" ] }
+] })";
+
+static const char *FUNCTION_NAMES[] = { "none", "red", "green", "blue", "white", "amber", "dimmer", "pan", "tilt" };
+
+static const uint16_t CENTER = 0x8000;
+
+bool FixtureProfile::has(const Function function) const
+{
+    return std::find_if(channels.begin(), channels.end(), [function](const ProfileChannel &c) {
+        return c.function == function;
+    }) != channels.end();
+}
+
+bool FixtureProfile::hasFine(const Function function) const
+{
+    return std::find_if(channels.begin(), channels.end(), [function](const ProfileChannel &c) {
+        return c.function == function && c.fine;
+    }) != channels.end();
+}
+
+size_t FixtureProfile::mix() const
+{
+    return (has(Function::WHITE) ? 1 : 0) | (has(Function::AMBER) ? 2 : 0);
+}
+
+static bool parseFunction(const std::string &name, Function *function)
+{
+    for (size_t i = 0; i < sizeof(FUNCTION_NAMES) / sizeof(FUNCTION_NAMES[0]); i++) {
+        if (name == FUNCTION_NAMES[i]) {
+            *function = static_cast<Function>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseChannel(const json &entry, ProfileChannel *channel)
+{
+    *channel = ProfileChannel();
+    if (entry.is_null()) {
+        return true;
+    }
+
+    std::string name;
+    float value = -1;
+    if (entry.is_string()) {
+        name = entry;
+    } else if (entry.is_object() && entry.value("function", json()).is_string()) {
+        name = entry["function"];
+        channel->fine = entry.value("fine", false);
+        value = entry.value("value", -1.0f);
+    } else {
+        return false;
+    }
+
+    static const std::string FINE = " fine";
+    if (name.size() > FINE.size() && name.compare(name.size() - FINE.size(), FINE.size(), FINE) == 0) {
+        channel->fine = true;
+        name.erase(name.size() - FINE.size());
+    }
+
+    if (!parseFunction(name, &channel->function)) {
+        return false;
+    }
+
+    // Nothing drives pan and tilt (yet), they stay where they are put
+    if (value >= 0) {
+        channel->value = round(std::min(value, 1.0f) * UINT16_MAX);
+    } else if (channel->function == Function::PAN || channel->function == Function::TILT) {
+        channel->value = CENTER;
+    }
+    return true;
+}
+
+const ProfileLibrary &ProfileLibrary::builtin()
+{
+    static const ProfileLibrary library = []() {
+        ProfileLibrary library;
+        library.parse(BUILTIN_PROFILES);
+        return library;
+    }();
+    return library;
+}
+
+bool ProfileLibrary::load(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file) {
+        SDL_Log("Profiles: could not open %s", path.c_str());
+        return false;
+    }
+
+    std::stringstream text;
+    text << file.rdbuf();
+    return parse(text.str());
+}
+
+bool ProfileLibrary::parse(const std::string &text)
+{
+    const json root = json::parse(text, nullptr, false);
+    if (root.is_discarded() || !root.is_object() || !root.value("profiles", json()).is_array()) {
+        SDL_Log("Profiles: expected an object with a profiles array");
+        return false;
+    }
+
+    // All or nothing
+    std::vector<FixtureProfile> profiles;
+    for (const json &entry : root["profiles"]) {
+        if (!entry.is_object()
+                || !entry.value("name", json()).is_string()
+                || !entry.value("channels", json()).is_array()
+                || entry["channels"].size() > 512) {
+            SDL_Log("Profiles: profiles need a name and a channels array: %s", entry.dump().c_str());
+            return false;
+        }
+
+        FixtureProfile profile;
+        profile.name = entry["name"];
+        profile.gamma = entry.value("gamma", 1.0f);
+        if (!(profile.gamma > 0 && profile.gamma <= 10)) {
+            SDL_Log("Profiles: gamma of %s out of range", profile.name.c_str());
+            return false;
+        }
+        for (const json &channel : entry["channels"]) {
+            profile.channels.emplace_back();
+            if (!parseChannel(channel, &profile.channels.back())) {
+                SDL_Log("Profiles: invalid channel %s in %s", channel.dump().c_str(), profile.name.c_str());
+                return false;
+            }
+        }
+        profiles.push_back(profile);
+    }
+
+    for (const FixtureProfile &profile : profiles) {
+        const size_t index = indexOf(profile.name);
+        if (index == SIZE_MAX) {
+            m_profiles.push_back(profile);
+        } else {
+            m_profiles[index] = profile;
+        }
+    }
+    return true;
+}
+
+const FixtureProfile *ProfileLibrary::find(const std::string &name) const
+{
+    const size_t index = indexOf(name);
+    return index == SIZE_MAX ? nullptr : &m_profiles[index];
+}
+
+size_t ProfileLibrary::indexOf(const std::string &name) const
+{
+    for (size_t i = 0; i < m_profiles.size(); i++) {
+        if (m_profiles[i].name == name) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+// Levels
+// ======
+
+static inline uint16_t f2uint16(const float f)
+{
+    return static_cast<uint16_t>(round(std::min(std::max(f, 0.0f), 1.0f) * UINT16_MAX));
+}
+
+void level::compute(const float rgb[3], const size_t mix, const float intensity, uint16_t levels[])
+{
+    // Effects may push the color out of range
+    float r = std::min(std::max(rgb[0], 0.0f), 1.0f);
+    float g = std::min(std::max(rgb[1], 0.0f), 1.0f);
+    float b = std::min(std::max(rgb[2], 0.0f), 1.0f);
+
+    // White is the part all three share
+    float w = 0;
+    if (mix & 1) {
+        w = std::min(r, std::min(g, b));
+        r -= w;
+        g -= w;
+        b -= w;
+    }
+
+    // Amber is roughly full red and half green
+    float a = 0;
+    if (mix & 2) {
+        a = std::min(r, 2 * g);
+        r -= a;
+        g -= a / 2;
+    }
+
+    const float mixed[COLORS] = { r, g, b, w, a };
+    for (size_t c = 0; c < COLORS; c++) {
+        levels[c] = f2uint16(mixed[c]);
+        levels[COLORS + c] = f2uint16(mixed[c] * intensity);
+    }
+    levels[INTENSITY] = f2uint16(intensity);
+}
+
+}
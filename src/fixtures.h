@@ -0,0 +1,122 @@
+#ifndef FIXTURES_H
+#define FIXTURES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace groggle
+{
+
+/// Which part of the spectrum drives a fixture's intensity.
+enum class Role : uint8_t
+{
+    BASS,
+    MID,
+    TREBLE,
+    COUNT
+};
+
+static const size_t ROLE_COUNT = static_cast<size_t>(Role::COUNT);
+
+/// What a fixture does with one of its channels.
+enum class Function : uint8_t
+{
+    NONE, // Not written, stays at zero
+    RED,
+    GREEN,
+    BLUE,
+    WHITE,
+    AMBER,
+    DIMMER,
+    PAN,
+    TILT
+};
+
+struct ProfileChannel
+{
+    Function function = Function::NONE;
+    bool fine = false; // Low byte of a 16 bit value, the coarse one is the high byte
+    int value = -1; // Fixed 16 bit value, -1 to follow the music
+};
+
+/**
+ * A fixture type's channel layout, starting at its address.
+ */
+struct FixtureProfile
+{
+    std::string name;
+    std::vector<ProfileChannel> channels;
+    float gamma = 1; // Response curve, the output is the level to this power
+
+    bool has(const Function function) const;
+    /// Whether the function has a low byte channel as well.
+    bool hasFine(const Function function) const;
+
+    /// Whether white (1) and amber (2) get taken out of the color, c.f. level::compute().
+    size_t mix() const;
+};
+
+/**
+ * Fixture profiles by name. A few common ones are built in, more come from
+ * JSON files:
+ *   { "profiles": [ { "name": "rgbw", "gamma": 2.2, "channels": [ "red", "green", "blue", "white" ] },
+ *                   { "name": "spot", "channels": [ "pan", "pan fine", null,
+ *                                                   { "function": "tilt", "value": 0.25 } ] } ] }
+ * Functions are red, green, blue, white, amber, dimmer, pan and tilt, with a
+ * " fine" suffix for the low byte. null skips a channel. Pan and tilt hold
+ * their value, the middle unless given (0-1). "gamma" corrects the response of
+ * all other channels, 1 (linear) if not given.
+ */
+class ProfileLibrary
+{
+public:
+    /// rgb, rgbw, rgba, rgb16, dimmer, dimmer16, tripar and movinghead
+    static const ProfileLibrary &builtin();
+
+    /// Adds the file's profiles, replacing any of the same name.
+    bool load(const std::string &path);
+    bool parse(const std::string &text);
+
+    /// @return nullptr if unknown
+    const FixtureProfile *find(const std::string &name) const;
+    size_t indexOf(const std::string &name) const; // SIZE_MAX if unknown
+    const FixtureProfile &at(const size_t index) const { return m_profiles[index]; }
+    size_t size() const { return m_profiles.size(); }
+
+private:
+    std::vector<FixtureProfile> m_profiles;
+};
+
+/**
+ * Per frame levels (16 bit) of one fixture, its channel writes copy from
+ * them: its color, the same dimmed by its intensity, then the intensity.
+ * Fixtures with white or amber channels get those parts taken out of their
+ * RGB.
+ */
+namespace level
+{
+static const size_t COLORS = 5; // red, green, blue, white, amber
+static const size_t INTENSITY = 2 * COLORS;
+static const size_t COUNT = INTENSITY + 1;
+
+/// @param function One of the color functions
+inline size_t plain(const Function function)
+{
+    return static_cast<size_t>(function) - static_cast<size_t>(Function::RED);
+}
+inline size_t dimmed(const Function function) { return COLORS + plain(function); }
+
+/**
+ * @param rgb The color, 0-1
+ * @param mix The fixture's FixtureProfile::mix()
+ * @param intensity 0-1
+ * @param levels COUNT values to fill
+ */
+void compute(const float rgb[3], const size_t mix, const float intensity, uint16_t levels[]);
+}
+
+}
+
+#endif
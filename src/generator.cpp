@@ -0,0 +1,186 @@
+#include "generator.h"
+
+#include <SDL_log.h>
+
+#include <algorithm> // min, max
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace groggle
+{
+namespace audio
+{
+
+static const double TWO_PI = 2 * M_PI;
+static const float CLICK_LENGTH = 0.005f; // s
+static const float CLICK_FREQUENCY = 2000; // Hz
+
+bool Generator::parse(const std::string &spec, Params *params)
+{
+    std::istringstream stream(spec);
+    std::string token;
+
+    std::getline(stream, token, ',');
+    if (token == "sine") {
+        params->signal = Signal::SINE;
+    } else if (token == "sweep") {
+        params->signal = Signal::SWEEP;
+    } else if (token == "pink") {
+        params->signal = Signal::PINK_NOISE;
+    } else if (token == "clicks") {
+        params->signal = Signal::CLICKS;
+    } else if (token == "silence") {
+        params->signal = Signal::SILENCE;
+    } else {
+        SDL_Log("Unknown test signal \"%s\"", token.c_str());
+        return false;
+    }
+
+    while (std::getline(stream, token, ',')) {
+        const size_t eq = token.find('=');
+        if (eq == std::string::npos) {
+            SDL_Log("Expected key=value, got \"%s\"", token.c_str());
+            return false;
+        }
+
+        const std::string key = token.substr(0, eq);
+        float value = 0;
+        try {
+            value = std::stof(token.substr(eq + 1));
+        } catch (const std::exception &) {
+            SDL_Log("Not a number: \"%s\"", token.c_str());
+            return false;
+        }
+
+        if (key == "rate") {
+            params->rate = value;
+        } else if (key == "amp") {
+            if (!(value >= 0 && value <= 1)) {
+                SDL_Log("The amplitude goes from 0 to 1, got \"%s\"", token.c_str());
+                return false;
+            }
+            params->amplitude = value;
+        } else if (key == "freq" || key == "from") {
+            params->frequency = value;
+        } else if (key == "to") {
+            params->frequencyEnd = value;
+        } else if (key == "period") {
+            params->period = value;
+        } else if (key == "bpm") {
+            params->bpm = value;
+        } else if (key == "seed") {
+            // Exact, a float only holds 24 bits
+            const std::string text = token.substr(eq + 1);
+            unsigned long seed = 0;
+            size_t end = 0;
+            try {
+                seed = std::stoul(text, &end);
+            } catch (const std::exception &) {
+                end = 0; // Rejected below
+            }
+            if (end != text.size() || text.find('-') != std::string::npos
+                    || seed > std::numeric_limits<uint32_t>::max()) {
+                SDL_Log("Seeds are whole numbers from 0 to 2^32 - 1, got \"%s\"", token.c_str());
+                return false;
+            }
+            params->seed = seed;
+        } else if (key == "duration") {
+            if (!(value >= 0)) {
+                SDL_Log("The duration must not be negative, got \"%s\"", token.c_str());
+                return false;
+            }
+            params->duration = value;
+        } else if (key == "speed") {
+            if (!(value >= 0)) {
+                SDL_Log("The speed must not be negative, got \"%s\"", token.c_str());
+                return false;
+            }
+            params->speed = value;
+        } else {
+            SDL_Log("Unknown test signal parameter \"%s\"", key.c_str());
+            return false;
+        }
+    }
+
+    if (!(params->rate > 0 && params->bpm > 0 && params->period > 0)) {
+        SDL_Log("The rate, bpm and period of test signals must be positive");
+        return false;
+    }
+    return true;
+}
+
+Generator::Generator(const Params &params)
+    : m_params(params)
+    , m_noiseState(params.seed != 0 ? params.seed : 1)
+{}
+
+void Generator::render(int16_t dst[], const size_t frameCount)
+{
+    const float scale = m_params.amplitude * std::numeric_limits<int16_t>::max();
+    for (size_t i = 0; i < frameCount; i++) {
+        dst[i] = std::round(std::min(std::max(next(), -1.0f), 1.0f) * scale);
+        m_position++;
+    }
+}
+
+float Generator::next()
+{
+    const double t = m_position / static_cast<double>(m_params.rate);
+
+    switch (m_params.signal) {
+    case Signal::SINE: {
+        const float value = std::sin(TWO_PI * m_phase);
+        m_phase = std::fmod(m_phase + m_params.frequency / m_params.rate, 1.0);
+        return value;
+    }
+    case Signal::SWEEP: {
+        // Exponential, so every octave takes the same time
+        const double progress = std::fmod(t, m_params.period) / m_params.period;
+        const double frequency = m_params.frequency * std::pow(m_params.frequencyEnd / m_params.frequency, progress);
+        const float value = std::sin(TWO_PI * m_phase);
+        m_phase = std::fmod(m_phase + frequency / m_params.rate, 1.0);
+        return value;
+    }
+    case Signal::PINK_NOISE: {
+        // Paul Kellet's refined pink filter, c.f. http://www.firstpr.com.au/dsp/pink-noise/
+        const float white = nextNoise();
+        m_pink[0] = 0.99886f * m_pink[0] + white * 0.0555179f;
+        m_pink[1] = 0.99332f * m_pink[1] + white * 0.0750759f;
+        m_pink[2] = 0.96900f * m_pink[2] + white * 0.1538520f;
+        m_pink[3] = 0.86650f * m_pink[3] + white * 0.3104856f;
+        m_pink[4] = 0.55000f * m_pink[4] + white * 0.5329522f;
+        m_pink[5] = -0.7616f * m_pink[5] - white * 0.0168980f;
+        const float pink = m_pink[0] + m_pink[1] + m_pink[2] + m_pink[3] + m_pink[4] + m_pink[5] + m_pink[6] + white * 0.5362f;
+        m_pink[6] = white * 0.115926f;
+        return pink * 0.11f; // Roughly back to -1..1
+    }
+    case Signal::CLICKS: {
+        // Beats start on exact frame numbers so they do not drift
+        const double beatLength = 60.0 / m_params.bpm * m_params.rate;
+        const uint64_t beat = std::floor(m_position / beatLength);
+        const uint64_t sinceBeat = m_position - static_cast<uint64_t>(std::ceil(beat * beatLength));
+        const float clickTime = sinceBeat / static_cast<float>(m_params.rate);
+        if (clickTime >= CLICK_LENGTH) {
+            return 0;
+        }
+        return std::sin(TWO_PI * CLICK_FREQUENCY * clickTime) * (1 - clickTime / CLICK_LENGTH);
+    }
+    case Signal::SILENCE:
+        return 0;
+    }
+
+    return 0;
+}
+
+float Generator::nextNoise()
+{
+    // xorshift32, good enough for audio and identical on every platform
+    m_noiseState ^= m_noiseState << 13;
+    m_noiseState ^= m_noiseState >> 17;
+    m_noiseState ^= m_noiseState << 5;
+    return m_noiseState / static_cast<float>(std::numeric_limits<uint32_t>::max()) * 2 - 1;
+}
+
+}
+}
@@ -0,0 +1,70 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace groggle
+{
+namespace audio
+{
+
+/**
+ * Deterministic test signal synthesizer. Renders mono s16 samples on demand,
+ * so it can be driven at any speed.
+ */
+class Generator
+{
+public:
+    enum class Signal {
+        SINE,
+        SWEEP, // Exponential sweep from frequency to frequencyEnd, repeating
+        PINK_NOISE,
+        CLICKS, // Short bursts at bpm
+        SILENCE
+    };
+
+    struct Params
+    {
+        Signal signal = Signal::SINE;
+        int rate = 44100; // Hz
+        float amplitude = 0.5f; // 0..1
+        float frequency = 440; // Hz
+        float frequencyEnd = 20000; // Hz, sweep only
+        float period = 10; // s, sweep only
+        float bpm = 120; // Clicks only
+        uint32_t seed = 1; // Noise only
+        float duration = 0; // s, 0 means endless
+        float speed = 1; // Relative to real time, 0 means as fast as possible
+    };
+
+    /**
+     * Parses a spec like "sine,freq=440,amp=0.8". Keys not given keep their
+     * value from params.
+     * @return false if the spec is malformed
+     */
+    static bool parse(const std::string &spec, Params *params);
+
+    Generator(const Params &params);
+
+    const Params &params() const { return m_params; }
+    uint64_t position() const { return m_position; }
+
+    void render(int16_t dst[], const size_t frameCount);
+
+private:
+    float next();
+    float nextNoise();
+
+    const Params m_params;
+    uint64_t m_position = 0; // Frames rendered so far
+    double m_phase = 0; // 0..1
+    uint32_t m_noiseState;
+    float m_pink[7] = {};
+};
+
+}
+}
+
+#endif
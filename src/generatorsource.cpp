@@ -0,0 +1,74 @@
+#include "generatorsource.h"
+
+#include <algorithm> // min
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using std::chrono::steady_clock;
+
+namespace groggle
+{
+namespace audio
+{
+
+static const size_t CHUNK_FRAMES = 1024;
+
+GeneratorSource::GeneratorSource(const Generator::Params &params)
+    : m_generator(params)
+{}
+
+bool GeneratorSource::open()
+{
+    const Generator::Params &params = m_generator.params();
+    Format format;
+    format.rate = params.rate;
+    format.channels = 1;
+    format.latency = CHUNK_FRAMES / static_cast<float>(params.rate);
+    format.duration = params.duration; // Signal time, speed only paces run()
+    setFormat(format);
+    return true;
+}
+
+int GeneratorSource::run()
+{
+    const Generator::Params &params = m_generator.params();
+    const uint64_t totalFrames = this->totalFrames();
+    std::vector<int16_t> chunk(CHUNK_FRAMES);
+
+    const auto start = steady_clock::now();
+    while (m_running && (totalFrames == 0 || m_generator.position() < totalFrames)) {
+        size_t count = CHUNK_FRAMES;
+        if (totalFrames > 0) {
+            count = std::min<uint64_t>(count, totalFrames - m_generator.position());
+        }
+
+        m_generator.render(chunk.data(), count);
+        deliver(chunk.data(), count);
+
+        if (params.speed > 0) {
+            const double seconds = m_generator.position() / (params.rate * static_cast<double>(params.speed));
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<steady_clock::duration>(
+                                              std::chrono::duration<double>(seconds)));
+        }
+    }
+
+    return 0;
+}
+
+size_t GeneratorSource::read(int16_t dst[], const size_t frameCount)
+{
+    // Endless signals would render forever, so they need a duration here.
+    const uint64_t totalFrames = this->totalFrames();
+    const size_t count = std::min<uint64_t>(frameCount, totalFrames - m_generator.position());
+    m_generator.render(dst, count);
+    return count;
+}
+
+uint64_t GeneratorSource::totalFrames() const
+{
+    return m_generator.params().duration * m_generator.params().rate;
+}
+
+}
+}
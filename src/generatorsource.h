@@ -0,0 +1,38 @@
+#ifndef GENERATORSOURCE_H
+#define GENERATORSOURCE_H
+
+#include "audiosource.h"
+#include "generator.h"
+
+#include <atomic>
+
+namespace groggle
+{
+namespace audio
+{
+
+/**
+ * Feeds generated audio into the pipeline, paced according to Params::speed.
+ */
+class GeneratorSource : public AudioSource
+{
+public:
+    GeneratorSource(const Generator::Params &params);
+
+    bool open() override;
+    int run() override;
+    void stop() override { m_running = false; }
+    std::string name() const override { return "Generator"; }
+    size_t read(int16_t dst[], const size_t frameCount) override;
+
+private:
+    uint64_t totalFrames() const;
+
+    Generator m_generator;
+    std::atomic<bool> m_running { true }; // Only stop() clears it
+};
+
+}
+}
+
+#endif
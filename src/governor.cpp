@@ -0,0 +1,70 @@
+#include "governor.h"
+
+#include <algorithm> // min, max
+
+namespace groggle
+{
+
+static const int WINDOW_FRAMES = 32;
+static const int MISSES_TO_STEP_DOWN = 2; // Per window
+static const int CLEAN_WINDOWS_TO_STEP_UP = 8;
+static const float HEADROOM_LOAD = 0.5f; // The level above costs up to twice as much
+
+std::vector<QualityGovernor::Level> QualityGovernor::ladder(const float analysisRate, const float outputRate)
+{
+    // Stop interpolating first, then halve the FFT work twice
+    const float plainRate = std::min(outputRate, analysisRate);
+    return {
+        { 1, analysisRate, outputRate },
+        { 1, analysisRate, plainRate },
+        { 2, analysisRate * 2 / 3, plainRate * 2 / 3 },
+        { 4, analysisRate / 2, plainRate / 2 },
+    };
+}
+
+QualityGovernor::QualityGovernor(const std::vector<Level> &levels)
+    : m_levels(levels)
+{}
+
+bool QualityGovernor::report(const bool missed, const float load)
+{
+    m_frames++;
+    m_misses += missed ? 1 : 0;
+    m_peakLoad = std::max(m_peakLoad, load);
+
+    // Step down right away, a stutter is worse than lower quality
+    if (m_misses >= MISSES_TO_STEP_DOWN) {
+        m_cleanWindows = 0;
+        if (m_level + 1 < levelCount()) {
+            setLevel(m_level + 1);
+            return true;
+        }
+        setLevel(m_level); // Lowest already, start a new window
+        return false;
+    }
+
+    if (m_frames < WINDOW_FRAMES) {
+        return false;
+    }
+
+    const bool clean = m_misses == 0 && m_peakLoad < HEADROOM_LOAD;
+    m_cleanWindows = clean ? m_cleanWindows + 1 : 0;
+    if (m_cleanWindows >= CLEAN_WINDOWS_TO_STEP_UP && m_level > 0) {
+        m_cleanWindows = 0;
+        setLevel(m_level - 1);
+        return true;
+    }
+
+    setLevel(m_level);
+    return false;
+}
+
+void QualityGovernor::setLevel(const int level)
+{
+    m_level = level;
+    m_frames = 0;
+    m_misses = 0;
+    m_peakLoad = 0;
+}
+
+}
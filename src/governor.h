@@ -0,0 +1,61 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <atomic>
+#include <vector>
+
+namespace groggle
+{
+
+/**
+ * Trades analysis quality for time. Steps down a ladder of quality levels
+ * when frames keep missing their deadlines, and back up once there has been
+ * headroom for a while.
+ */
+class QualityGovernor
+{
+public:
+    struct Level
+    {
+        int decimation = 1; // Analyze every n-th sample, FFT size / n
+        float analysisRate = 30; // Hz
+        float outputRate = 44; // Hz
+    };
+
+    /// The default ladder, starting at full quality.
+    static std::vector<Level> ladder(const float analysisRate, const float outputRate);
+
+    QualityGovernor(const std::vector<Level> &levels);
+
+    /**
+     * To be called once per output frame.
+     * @param missed Whether this frame or any stage feeding it missed its
+     * deadline since the last call
+     * @param load Busy time of the most loaded stage relative to its interval
+     * @return Whether the level changed
+     */
+    bool report(const bool missed, const float load);
+
+    /// 0 is full quality. Thread safe.
+    int level() const { return m_level; }
+    int levelCount() const { return m_levels.size(); }
+    const std::vector<Level> &levels() const { return m_levels; }
+    /// Together with level(), index levels() instead, the level may change between calls.
+    const Level &current() const { return m_levels[m_level]; }
+
+private:
+    void setLevel(const int level);
+
+    const std::vector<Level> m_levels;
+    std::atomic<int> m_level { 0 };
+
+    // Current observation window
+    int m_frames = 0;
+    int m_misses = 0;
+    float m_peakLoad = 0;
+    int m_cleanWindows = 0; // In a row, with no misses and headroom
+};
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace groggle
+{
+
+/**
+ * Hands the newest value from exactly one producer thread to one consumer
+ * thread, lock-free. A value the consumer has not taken yet is replaced by the
+ * next one, so neither side ever waits and the consumer never gets a stale
+ * value while a newer one exists.
+ *
+ * Three slots: the producer writes into its own, then swaps it with the shared
+ * middle one; the consumer swaps its own with the middle one when that is
+ * fresh.
+ */
+template <typename T>
+class Mailbox
+{
+public:
+    /// Producer only. @return false if an unread value was replaced
+    bool put(T value) {
+        m_slots[m_back] = std::move(value);
+        const uint8_t previous = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel);
+        m_back = previous & INDEX;
+        return !(previous & FRESH);
+    }
+
+    /// Consumer only. @return false if nothing was put since the last take
+    bool take(T *value) {
+        if (!(m_middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+
+        const uint8_t previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+        m_front = previous & INDEX;
+        *value = std::move(m_slots[m_front]);
+        return true;
+    }
+
+private:
+    static const uint8_t INDEX = 3;
+    static const uint8_t FRESH = 4;
+
+    T m_slots[3];
+    // Separate cache lines, producer and consumer each own one of the indices
+    alignas(64) uint8_t m_back = 0;
+    alignas(64) std::atomic<uint8_t> m_middle { 1 };
+    alignas(64) uint8_t m_front = 2;
+};
+
+}
+
+#endif
@@ -1,12 +1,20 @@
-#include "audiometadata.h"
+#include "analysiscache.h"
+#include "analyzer.h"
+#include "asyncsink.h"
+#include "audiosource.h"
+#include "cueplayer.h"
+#include "cuesink.h"
+#include "eventloop.h"
 #include "olaoutput.h"
+#include "olasink.h"
 #include "painput.h"
-#include "sdlinput.h"
+#include "patch.h"
+#include "pipeline.h"
+#include "realtime.h"
 #include "spectrum.h"
-#include "timer.h"
 #include "mqttcontrol.h"
-
-#include <fftw3.h>
+#include "netsink.h"
+#include "nullsink.h"
 
 #include <SDL.h>
 #include <SDL_audio.h>
@@ -14,125 +22,127 @@
 
 #include <tclap/CmdLine.h>
 
+#include <signal.h>
+#include <unistd.h>
+
 #include <algorithm> // min, max
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <thread>
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 using namespace groggle;
 using namespace TCLAP;
 
 struct Options
 {
-    enum class InputType {
-        FILE,
-        DEVICE
-    };
-    InputType inputType;
-
     std::string audioDevice;
     std::string inputFile;
+    std::string renderFile;
+    std::string cueFile;
     bool listDevices;
+    bool noCache;
+    bool audioTrigger;
+    float outputRate;
+    bool fixedQuality;
+    float idleAfter;
+    int silenceLevel;
+    rt::ThreadPolicy capturePolicy;
+    rt::ThreadPolicy analysisPolicy;
+    rt::ThreadPolicy renderPolicy;
+    rt::ThreadPolicy outputPolicy;
+    bool lockMemory;
+    bool eventLoop;
+    Patch patch;
+    std::string output; // ola, artnet, sacn, cue or null
+    std::string outputHost; // Empty for broadcast/multicast
+    std::string outputFile; // cue only
+    uint16_t outputPort;
+    float keepalive; // s
+    bool dither;
+    float fadeTime; // s
 };
 
-static inline float magnitude(const float f[])
+// The amount of frames analyzed at a time. Also determines the frequency
+// resolution of the Fourier transformation.
+// TODO Um. Size or count? What is this?
+static const int FRAME_SIZE = 1024;
+static const float LIGHT_RATE = 30; // Hz, analysis
+static const float DEFAULT_OUTPUT_RATE = 44; // Hz, about a full DMX512 universe
+static const float DEFAULT_KEEPALIVE = 1; // s, below the sACN and Art-Net timeouts
+static const float DEFAULT_FADE_TIME = 0.5f; // s
+static const size_t RECORD_FRAMES = 64; // Per write to a cue file recorded live
+
+void logAnalysisInfo(const audio::Format &format, const Options &options)
 {
-    return sqrt(pow(f[0], 2) + pow(f[1], 2));
+    const int freqStep = floor(format.rate / (float)FRAME_SIZE);
+    const int binCount = audio::Analyzer::binCount(FRAME_SIZE, format.channels);
+    SDL_Log("Buckets: %i", binCount);
+    SDL_Log("Frequency bucket size: %i Hz", freqStep);
+    SDL_Log("Max frequency: %i Hz", binCount * freqStep);
+    SDL_Log("Analysis rate: %.1f Hz, output rate: %.1f Hz", LIGHT_RATE, options.outputRate);
 }
 
-/**
- * @param data The audio data to transform in s16le format
- * @param sampleCount Length of the audio data in samples
- * @param in Preallocated FFTW input array
- * @param out Preallocated FFTW output array
- */
-static audio::Spectrum transform(const int16_t data[], const size_t sampleCount, const int channels, float *in, fftwf_complex *out)
+PipelineConfig pipelineConfig(const Options &options, std::shared_ptr<MQTT> mqtt, std::shared_ptr<AsyncSink> sender)
 {
-    fftwf_plan p;
-    p = fftwf_plan_dft_r2c_1d(sampleCount, in, out, FFTW_ESTIMATE);
-
-    // plan_dft_r2c modifies the input array, *must* copy here!
-    for (size_t i = 0; i < sampleCount; i++) {
-        in[i] = data[i * channels] / (float)std::numeric_limits<int16_t>::max();
-    }
-
-    fftwf_execute(p);
-
-    // "Realize", normalize and store the result
-    // Scaling: http://fftw.org/fftw3_doc/The-1d-Discrete-Fourier-Transform-_0028DFT_0029.html#The-1d-Discrete-Fourier-Transform-_0028DFT_0029
-    const float scaleFactor = 2.0f / sampleCount;
-
-    // Store intensities for each frequency bucket at one point in time.
-    // Only copy the first half: positive frequencies. See above link. (Not sure about this.)
-    audio::Spectrum spectrum;
-    for(size_t i = 0; i < sampleCount / channels / 2; i++) {
-        spectrum.push_back(magnitude(out[i]) * scaleFactor);
-    }
-
-    // TODO Print something like a graphic equalizer? Render with SDL?
-
-    fftwf_destroy_plan(p);
-    return spectrum;
+    PipelineConfig config;
+    config.frameSize = FRAME_SIZE;
+    config.analysisRate = LIGHT_RATE;
+    config.outputRate = options.outputRate;
+    config.audioTrigger = options.audioTrigger;
+    config.analysisPolicy = options.analysisPolicy;
+    config.renderPolicy = options.renderPolicy;
+    config.sender = sender;
+    config.adaptive = !options.fixedQuality;
+    config.idleAfter = options.idleAfter;
+    config.qualityChanged = [mqtt](const int level) {
+        mqtt->postMetric("quality", level);
+    };
+    return config;
 }
 
-void lightLoop(AudioMetadataPtr meta, std::shared_ptr<OlaOutput> olaOutput)
+/**
+ * @param series Pre-analyzed spectra of the whole input, if available.
+ * Replaces the live analysis of the buffer.
+ */
+void lightLoop(const audio::Format format,
+               std::shared_ptr<audio::SampleBuffer> buffer,
+               std::shared_ptr<audio::SpectrumSeries> series,
+               std::shared_ptr<OlaOutput> olaOutput,
+               std::shared_ptr<AsyncSink> sender,
+               std::shared_ptr<MQTT> mqtt,
+               const Options options)
 {
-    // Hack. Wait for the first audio data to arrive so that we can compute the
-    // frequency data that is printed below.
-    bool ready = false;
-    do {
-        std::lock_guard<std::mutex>(meta->mutex);
-        ready = meta->dataSize > 0;
-    } while (!ready);
-
-    // The amount of frames analyzed at a time. Also determines the frequency
-    // resolution of the Fourier transformation.
-    // TODO Um. Size or count? What is this?
-    static const int FRAME_SIZE = 1024;
-    const int freqStep = floor(meta->fileSpec.freq / (float)FRAME_SIZE);
-    SDL_Log("Buckets: %i", FRAME_SIZE / 2);
-    SDL_Log("Frequency bucket size: %i Hz", freqStep);
-    SDL_Log("Max frequency: %i Hz", FRAME_SIZE / 2 * freqStep);
-
-    // FFTW input/output buffers are recycled
-    float *in = (float*)fftwf_malloc(sizeof(float) * FRAME_SIZE);
-    fftwf_complex *out = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * FRAME_SIZE / 2 + 1);
-
-    // "Playback" timing
-    Timer timer(meta->duration /*s*/, 30 /*Hz*/);
-    timer.setCallback([meta, in, out, olaOutput](const long long /*elapsed*/) {
-        if(!olaOutput->isEnabled()) {
+    // Wait for the first window of audio data, the timer's show time starts
+    // with it
+    while (!buffer->waitFor(FRAME_SIZE, std::chrono::seconds(1))) {
+        if (buffer->isClosed()) {
+            SDL_Log("Source ended before delivering any audio.");
             return;
         }
+    }
 
-        meta->mutex.lock();
-        const int16_t *data = reinterpret_cast<int16_t*>(meta->data);
-        const uint32_t sampleCount = meta->dataSize / 2; // Casting int8 -> int16 halves dataSize as well!
-        const uint32_t dataPos = std::min(meta->position / 2, sampleCount - FRAME_SIZE * meta->fileSpec.channels);
-        const audio::Spectrum spectrum = transform(&data[dataPos], FRAME_SIZE, meta->fileSpec.channels, in, out);
-        meta->mutex.unlock();
-        olaOutput->update(spectrum);
-    });
-    timer.run();
-
-    fftwf_free(out);
-    fftwf_free(in);
+    logAnalysisInfo(format, options);
+    LightPipeline pipeline(format, buffer, series, olaOutput, pipelineConfig(options, mqtt, sender));
+    pipeline.run();
 
     olaOutput->blackout();
+    sender->flush(std::chrono::seconds(1));
     SDL_Log("Light thread done.");
 }
 
-void mqttLoop(std::shared_ptr<OlaOutput> olaOutput)
+/// Connects the MQTT state to the output and publishes the initial state.
+void setupMqtt(MQTT *mqtt, std::shared_ptr<OlaOutput> olaOutput)
 {
-    MQTT mqtt;
-    mqtt.init();
-
-    mqtt.setStateCallback([&mqtt, olaOutput](const State &newState) {
+    mqtt->setStateCallback([mqtt, olaOutput](const State &newState) {
         SDL_Log(">> Enabled: %i Hue: %f Sat: %f",
             newState.enabled, newState.color.h(), newState.color.s());
 
@@ -144,19 +154,66 @@ void mqttLoop(std::shared_ptr<OlaOutput> olaOutput)
             olaOutput->setColor(newState.color);
         }
 
+        if (newState.brightness >= 0) {
+            olaOutput->setBrightness(newState.brightness);
+        }
+
         State acceptedState;
         acceptedState.enabled = olaOutput->isEnabled();
         acceptedState.color = olaOutput->color();
-        mqtt.publish(acceptedState);
+        acceptedState.brightness = olaOutput->brightness();
+        mqtt->publish(acceptedState);
     });
 
     // Publish initial properties
-    mqtt.publishInfo();
+    mqtt->publishInfo();
     State initialState;
     initialState.enabled = olaOutput->isEnabled();
     initialState.color = olaOutput->color();
-    mqtt.publish(initialState);
-    mqtt.run();
+    initialState.brightness = olaOutput->brightness();
+    mqtt->publish(initialState);
+}
+
+void mqttLoop(std::shared_ptr<MQTT> mqtt, std::shared_ptr<OlaOutput> olaOutput)
+{
+    setupMqtt(mqtt.get(), olaOutput);
+    mqtt->run();
+}
+
+/**
+ * Runs capture, analysis, output and MQTT on the calling thread, all served
+ * by the source's main loop. The OLA client only ever writes, so frames are
+ * sent straight from the frame timer.
+ */
+int eventLoopMain(audio::AudioSource &source,
+                  std::shared_ptr<OlaOutput> olaOutput,
+                  std::shared_ptr<MQTT> mqtt,
+                  const Options &options)
+{
+    EventLoop loop;
+    if (!loop.isOpen()) {
+        return -1;
+    }
+
+    if (!source.attach(loop)) {
+        SDL_Log("%s cannot run in the event loop, only PulseAudio can.", source.name().c_str());
+        return -1;
+    }
+
+    if (mqtt->attach(loop)) {
+        setupMqtt(mqtt.get(), olaOutput);
+    }
+
+    // Capture runs on this thread too, under the render policy
+    rt::applyToCurrentThread("event loop", options.renderPolicy);
+    logAnalysisInfo(source.format(), options);
+    LightPipeline pipeline(source.format(), source.buffer(), nullptr, olaOutput, pipelineConfig(options, mqtt, nullptr));
+    pipeline.attach(loop);
+
+    const int result = source.run();
+    pipeline.detach();
+    olaOutput->blackout();
+    return result;
 }
 
 void printAudioDevices()
@@ -176,11 +233,84 @@ void printAudioDevices()
         for (auto it = sinks.begin(); it != sinks.end(); it++) {
             std::cout << "\t- " << *it << ".monitor" << std::endl;
         }
-
-        audio::pulse::quit(0);
     });
 }
 
+/// ola, or artnet/sacn with optional :host[:port]
+bool parseOutput(const std::string &spec, Options *options)
+{
+    const size_t colon = spec.find(':');
+    options->output = spec.substr(0, colon);
+    options->outputHost.clear();
+    options->outputFile.clear();
+    options->outputPort = 0;
+    if (options->output == "ola" || options->output == "null") {
+        return colon == std::string::npos;
+    }
+    if (options->output == "cue") {
+        options->outputFile = colon == std::string::npos ? "" : spec.substr(colon + 1);
+        return !options->outputFile.empty();
+    }
+    if (options->output != "artnet" && options->output != "sacn") {
+        return false;
+    }
+    if (colon == std::string::npos) {
+        return true;
+    }
+
+    const std::string target = spec.substr(colon + 1);
+    const size_t portColon = target.find(':');
+    options->outputHost = target.substr(0, portColon);
+    if (portColon != std::string::npos) {
+        const int port = atoi(target.c_str() + portColon + 1);
+        if (port <= 0 || port > UINT16_MAX) {
+            return false;
+        }
+        options->outputPort = port;
+    }
+    return !options->outputHost.empty();
+}
+
+std::shared_ptr<DmxSink> openOutput(const Options &options)
+{
+    if (options.output == "ola") {
+        return std::make_shared<OlaSink>();
+    }
+    if (options.output == "null") {
+        SDL_Log("Discarding all DMX output");
+        return std::make_shared<NullSink>();
+    }
+    if (options.output == "cue") {
+        // Timestamps relative to the start, in real time
+        const auto start = std::chrono::steady_clock::now();
+        const size_t universes = ChannelPlan(options.patch).universes().size();
+        auto sink = std::make_shared<CueSink>(options.outputFile, [start]() -> uint64_t {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        }, RECORD_FRAMES * universes * cue::MAX_RECORD_SIZE);
+        if (!sink->isOpen()) {
+            return nullptr;
+        }
+        SDL_Log("Recording DMX to %s", options.outputFile.c_str());
+        return sink;
+    }
+
+    const net::Protocol protocol = options.output == "artnet" ? net::Protocol::ARTNET : net::Protocol::SACN;
+    for (const uint16_t universe : ChannelPlan(options.patch).universes()) {
+        if (!net::isValidUniverse(protocol, universe)) {
+            SDL_Log("%s cannot address universe %u, %s", options.output.c_str(), universe,
+                    protocol == net::Protocol::ARTNET ? "Art-Net goes up to 32767" : "sACN has 1-63999");
+            return nullptr;
+        }
+    }
+    auto sink = std::make_shared<NetSink>(protocol, options.outputHost, options.outputPort);
+    if (!sink->isOpen()) {
+        return nullptr;
+    }
+    SDL_Log("Sending %s to %s", options.output.c_str(),
+            options.outputHost.empty() ? "everyone" : options.outputHost.c_str());
+    return sink;
+}
+
 bool parseArgs(const int argc, const char **argv, Options *options)
 {
     try {
@@ -188,7 +318,7 @@ bool parseArgs(const int argc, const char **argv, Options *options)
 
         ValueArg<std::string> deviceArg("d",
                                        "device",
-                                       "Audio device name",
+                                       "Audio device name, or gen:<signal>[,key=value...] for a test signal (sine, sweep, pink, clicks, silence)",
                                        false,
                                        "",
                                        "string");
@@ -208,11 +338,212 @@ bool parseArgs(const int argc, const char **argv, Options *options)
                                           "string");
         cmd.add(fileNameArg);
 
+        ValueArg<std::string> renderArg("r",
+                                        "render",
+                                        "Analyzes the input as fast as possible and writes the light show to the given cue file instead of playing it.",
+                                        false,
+                                        "",
+                                        "string");
+        cmd.add(renderArg);
+
+        ValueArg<std::string> cueArg("c",
+                                     "cue",
+                                     "Plays a pre-rendered cue file instead of analyzing the input. Audio from --file plays along.",
+                                     false,
+                                     "",
+                                     "string");
+        cmd.add(cueArg);
+
+        SwitchArg noCacheArg("",
+                             "no-cache",
+                             "Analyzes files during playback instead of using (and filling) the analysis cache.",
+                             false);
+        cmd.add(noCacheArg);
+
+        SwitchArg audioTriggerArg("",
+                                  "audio-trigger",
+                                  "Analyzes live input as soon as new audio arrived instead of on a fixed timer.",
+                                  false);
+        cmd.add(audioTriggerArg);
+
+        ValueArg<float> outputRateArg("",
+                                      "output-rate",
+                                      "How often the lights are updated in Hz. Analysis frames are interpolated in between.",
+                                      false,
+                                      DEFAULT_OUTPUT_RATE,
+                                      "Hz");
+        cmd.add(outputRateArg);
+
+        SwitchArg fixedQualityArg("",
+                                  "fixed-quality",
+                                  "Never lowers the FFT size and the analysis and output rates when frames miss their deadlines.",
+                                  false);
+        cmd.add(fixedQualityArg);
+
+        ValueArg<float> idleAfterArg("",
+                                     "idle-after",
+                                     "Stops analysis and DMX output of live input after this many seconds of silence, 0 never does.",
+                                     false,
+                                     30,
+                                     "s");
+        cmd.add(idleAfterArg);
+
+        ValueArg<int> silenceLevelArg("",
+                                      "silence-level",
+                                      "Samples up to this level (0-32767) count as silence.",
+                                      false,
+                                      64,
+                                      "level");
+        cmd.add(silenceLevelArg);
+
+        const std::string policyHelp = " thread scheduling as <fifo|rr|other>[:priority][@cpu], e.g. fifo:80@2.";
+        ValueArg<std::string> capturePolicyArg("",
+                                               "rt-capture",
+                                               "Audio capture, PulseAudio and generators only," + policyHelp,
+                                               false,
+                                               "",
+                                               "policy");
+        cmd.add(capturePolicyArg);
+
+        ValueArg<std::string> analysisPolicyArg("",
+                                                "rt-analysis",
+                                                "Analysis" + policyHelp,
+                                                false,
+                                                "",
+                                                "policy");
+        cmd.add(analysisPolicyArg);
+
+        ValueArg<std::string> renderPolicyArg("",
+                                              "rt-render",
+                                              "Light rendering" + policyHelp,
+                                              false,
+                                              "",
+                                              "policy");
+        cmd.add(renderPolicyArg);
+
+        ValueArg<std::string> outputPolicyArg("",
+                                              "rt-output",
+                                              "DMX output" + policyHelp,
+                                              false,
+                                              "",
+                                              "policy");
+        cmd.add(outputPolicyArg);
+
+        SwitchArg lockMemoryArg("",
+                                "mlock",
+                                "Locks all memory into RAM to avoid page faults in the realtime threads.",
+                                false);
+        cmd.add(lockMemoryArg);
+
+        SwitchArg eventLoopArg("",
+                               "event-loop",
+                               "Runs everything on one thread in the PulseAudio main loop, for single core boards. Needs PulseAudio input, --rt-render applies to that thread.",
+                               false);
+        cmd.add(eventLoopArg);
+
+        ValueArg<std::string> patchArg("p",
+                                       "patch",
+                                       "JSON file listing the fixtures by universe, start address, type and role. Defaults to a single Tripar at 1.70.",
+                                       false,
+                                       "",
+                                       "string");
+        cmd.add(patchArg);
+
+        ValueArg<std::string> profilesArg("",
+                                          "profiles",
+                                          "JSON file with fixture profiles (channel layouts) to use in the patch, in addition to the built-in ones.",
+                                          false,
+                                          "",
+                                          "string");
+        cmd.add(profilesArg);
+
+        ValueArg<std::string> outputArg("o",
+                                        "output",
+                                        "Where DMX goes: ola (via olad), or artnet or sacn straight from here, optionally to a single host, e.g. sacn:10.0.0.5 or artnet:10.0.0.5:6454. Without a host Art-Net broadcasts and sACN uses multicast. cue:<file> records a cue file instead, null discards everything.",
+                                        false,
+                                        "ola",
+                                        "string");
+        cmd.add(outputArg);
+
+        ValueArg<float> keepaliveArg("",
+                                     "keepalive",
+                                     "Seconds after which universes that did not change are sent again, 0 sends all of them every frame.",
+                                     false,
+                                     DEFAULT_KEEPALIVE,
+                                     "float");
+        cmd.add(keepaliveArg);
+
+        SwitchArg ditherArg("",
+                            "dither",
+                            "Dithers 8 bit channels over time, for smoother fades at low levels. Keeps changing universes, so they are sent every frame.",
+                            false);
+        cmd.add(ditherArg);
+
+        ValueArg<float> fadeArg("",
+                                "fade",
+                                "Seconds color changes take to fade over, through OKLab. 0 switches at once.",
+                                false,
+                                DEFAULT_FADE_TIME,
+                                "float");
+        cmd.add(fadeArg);
+
         cmd.parse(argc, argv);
-        options->inputType = fileNameArg.isSet() ? Options::InputType::FILE : Options::InputType::DEVICE;
         options->inputFile = fileNameArg.getValue();
+        options->renderFile = renderArg.getValue();
+        options->cueFile = cueArg.getValue();
         options->audioDevice = deviceArg.getValue();
         options->listDevices = devicesArg.getValue();
+        options->noCache = noCacheArg.getValue();
+        options->audioTrigger = audioTriggerArg.getValue();
+        options->outputRate = outputRateArg.getValue();
+        options->fixedQuality = fixedQualityArg.getValue();
+        options->idleAfter = idleAfterArg.getValue();
+        options->silenceLevel = silenceLevelArg.getValue();
+        if (options->idleAfter < 0 || options->silenceLevel < 0 || options->silenceLevel > 32767) {
+            std::cerr << "Idle time and silence level must not be negative" << std::endl;
+            return false;
+        }
+        if (options->outputRate <= 0) {
+            std::cerr << "Output rate must be positive" << std::endl;
+            return false;
+        }
+
+        options->keepalive = keepaliveArg.getValue();
+        if (options->keepalive < 0) {
+            std::cerr << "Keepalive must not be negative" << std::endl;
+            return false;
+        }
+        options->dither = ditherArg.getValue();
+        options->fadeTime = fadeArg.getValue();
+        if (options->fadeTime < 0) {
+            std::cerr << "Fade time must not be negative" << std::endl;
+            return false;
+        }
+
+        options->lockMemory = lockMemoryArg.getValue();
+        options->eventLoop = eventLoopArg.getValue();
+        if (!rt::ThreadPolicy::parse(capturePolicyArg.getValue(), &options->capturePolicy)
+                || !rt::ThreadPolicy::parse(analysisPolicyArg.getValue(), &options->analysisPolicy)
+                || !rt::ThreadPolicy::parse(renderPolicyArg.getValue(), &options->renderPolicy)
+                || !rt::ThreadPolicy::parse(outputPolicyArg.getValue(), &options->outputPolicy)) {
+            return false;
+        }
+
+        if (!parseOutput(outputArg.getValue(), options)) {
+            std::cerr << "Unknown output " << outputArg.getValue() << std::endl;
+            return false;
+        }
+
+        ProfileLibrary profiles = ProfileLibrary::builtin();
+        if (!profilesArg.getValue().empty() && !profiles.load(profilesArg.getValue())) {
+            return false;
+        }
+
+        if (patchArg.getValue().empty()) {
+            options->patch = Patch::builtin(profiles);
+        } else if (!Patch::load(patchArg.getValue(), profiles, &options->patch)) {
+            return false;
+        }
     } catch (ArgException &e) {
         std::cerr << "Failed to parse command line: " << e.argId() << ": " << e.error() << std::endl;
         return false;
@@ -221,37 +552,126 @@ bool parseArgs(const int argc, const char **argv, Options *options)
     return true;
 }
 
-int liveMain(std::thread lightThread, AudioMetadataPtr meta)
+/**
+ * Looks up the analysis of the input file in the cache, analyzing it first
+ * if necessary.
+ */
+std::shared_ptr<audio::SpectrumSeries> loadAnalysis(const audio::SourceOptions &sourceOptions, const audio::Format &format)
 {
-    if (!audio::sdl::openInputDevice(meta)) {
-        SDL_Log("Not an SDL audio device, trying PulseAudio (%s)", SDL_GetError());
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t contentHash = audio::AnalysisCache::hashFile(sourceOptions.file);
+    if (contentHash == 0) {
+        return nullptr;
     }
 
-    if (!audio::pulse::run(meta)) { // Returns an error or blocks via the PA main loop
-        SDL_Log("Not a PulseAudio device, giving up.");
+    audio::SeriesParams params;
+    params.frameSize = FRAME_SIZE;
+    params.binCount = audio::Analyzer::binCount(FRAME_SIZE, format.channels);
+    params.tickRate = LIGHT_RATE;
+
+    audio::AnalysisCache cache;
+    if (auto series = cache.find(contentHash, params)) {
+        SDL_Log("Using cached analysis (%u frames)", series->frameCount());
+        return series;
+    }
+
+    audio::SourceOptions offlineOptions = sourceOptions;
+    offlineOptions.offline = true;
+    std::unique_ptr<audio::AudioSource> source = audio::openSource(offlineOptions);
+    std::unique_ptr<audio::SeriesWriter> writer = cache.create(contentHash, params);
+    if (!source || !writer) {
+        return nullptr;
+    }
+
+    audio::Analyzer analyzer(FRAME_SIZE);
+    audio::analyzeAll(*source, analyzer, LIGHT_RATE,
+        [&writer](const uint64_t /*timestamp*/, const audio::Spectrum &spectrum) {
+            writer->append(spectrum);
+        });
+
+    if (!writer->commit()) {
+        return nullptr;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    SDL_Log("Analyzed \"%s\" in %.3f s", sourceOptions.file.c_str(), seconds);
+    return cache.find(contentHash, params);
+}
+
+int renderMain(const Options &options)
+{
+    audio::SourceOptions sourceOptions;
+    sourceOptions.device = options.audioDevice;
+    sourceOptions.file = options.inputFile;
+    sourceOptions.offline = true;
+    std::unique_ptr<audio::AudioSource> source = audio::openSource(sourceOptions);
+    if (!source) {
         return -1;
     }
 
-    lightThread.join();
-    //audio::sdl::closeInputDevice(meta); // Technically we need to close *only* if using SDL. Will never happen though.
+    const audio::Format format = source->format();
+    if (format.duration <= 0) {
+        SDL_Log("Cannot render an endless input, give it a duration.");
+        return -1;
+    }
+
+    // Show time is what the light thread's timer would report
+    uint64_t showTime = 0;
+    auto sink = std::make_shared<CueSink>(options.renderFile, [&showTime]() { return showTime; });
+    if (!sink->isOpen()) {
+        return -1;
+    }
+
+    OlaOutput olaOutput(sink, options.patch);
+    audio::Analyzer analyzer(FRAME_SIZE);
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t ticks = audio::analyzeAll(*source, analyzer, LIGHT_RATE,
+        [&showTime, &olaOutput](const uint64_t timestamp, const audio::Spectrum &spectrum) {
+            showTime = timestamp;
+            olaOutput.update(spectrum);
+        });
+
+    olaOutput.blackout();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    SDL_Log("Rendered %lu frames (%.1f s of audio) in %.3f s: %.0f frames/s, %.1fx real time",
+            static_cast<unsigned long>(ticks),
+            format.duration,
+            seconds,
+            ticks / seconds,
+            format.duration / seconds);
     return 0;
 }
 
-int fileMain(std::thread lightThread, AudioMetadataPtr meta)
+int cueMain(const Options &options)
 {
-    if (!audio::sdl::loadFile(meta)) {
-        SDL_Log("Error loading \"%s\": %s", meta->inputFile.c_str(), SDL_GetError());
+    std::shared_ptr<DmxSink> sink = openOutput(options);
+    if (!sink) {
         return -1;
     }
 
-    if (!audio::sdl::openOutputDevice(meta)) {
-        SDL_Log("Error opening audio device \"%s\": %s", meta->audioDevice.c_str(), SDL_GetError());
+    CuePlayer player(options.cueFile, sink);
+    if (!player.isOpen()) {
         return -1;
     }
 
-    lightThread.join();
-    audio::sdl::closeOutputDevice(meta);
-    return 0;
+    if (options.inputFile.empty()) {
+        player.play();
+        return 0;
+    }
+
+    audio::SourceOptions sourceOptions;
+    sourceOptions.device = options.audioDevice;
+    sourceOptions.file = options.inputFile;
+    std::unique_ptr<audio::AudioSource> source = audio::openSource(sourceOptions);
+    if (!source) {
+        return -1;
+    }
+
+    std::thread playerThread([&player]() { player.play(); });
+    const int result = source->run();
+    player.stop();
+    playerThread.join();
+    return result;
 }
 
 void cleanup()
@@ -259,6 +679,25 @@ void cleanup()
     SDL_Quit();
 }
 
+/**
+ * Ends the input on SIGINT or SIGTERM, so everything shuts down as after a
+ * file and recordings get closed. A second signal quits right away. Both must
+ * be blocked in every thread, this one takes them with sigwait().
+ */
+void stopOnSignal(const sigset_t signals, std::shared_ptr<audio::AudioSource> source)
+{
+    int number = 0;
+    if (sigwait(&signals, &number) != 0) {
+        return;
+    }
+    SDL_Log("Got signal %d, stopping. Again to quit right away.", number);
+    source->stop();
+
+    if (sigwait(&signals, &number) == 0) {
+        _exit(1);
+    }
+}
+
 int main(const int argc, const char **argv)
 {
     Options options;
@@ -277,23 +716,95 @@ int main(const int argc, const char **argv)
         return 0;
     }
 
+    if (!options.renderFile.empty()) {
+        return renderMain(options);
+    }
+
+    if (!options.cueFile.empty()) {
+        return cueMain(options);
+    }
+
+    // Before the source and the threads allocate, so it covers them all
+    if (options.lockMemory) {
+        rt::lockMemory();
+    }
+
+    // Blocked before any thread starts, so all of them inherit the mask and
+    // only stopOnSignal() gets these
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
 
-    AudioMetadataPtr meta = std::make_shared<AudioMetadata>();
+    audio::SourceOptions sourceOptions;
     // TODO Use PA's default sink monitor as input device
-    meta->audioDevice = options.audioDevice;
-    meta->inputFile = options.inputFile;
+    sourceOptions.device = options.audioDevice;
+    sourceOptions.file = options.inputFile;
+    sourceOptions.eventLoop = options.eventLoop;
+    std::shared_ptr<audio::AudioSource> source = audio::openSource(sourceOptions);
+    if (!source) {
+        SDL_Log("No usable audio source, giving up.");
+        return -1;
+    }
+    source->buffer()->setSilenceThreshold(options.silenceLevel);
+    std::thread(stopOnSignal, stopSignals, source).detach();
+
+    std::shared_ptr<DmxSink> sink = openOutput(options);
+    if (!sink) {
+        return -1;
+    }
+
+    // Sends are synchronous on the event loop, there is no other thread to
+    // wait for them
+    std::shared_ptr<AsyncSink> sender;
+    if (!options.eventLoop) {
+        sender = std::make_shared<AsyncSink>(sink, options.outputPolicy);
+        sink = sender;
+    }
 
-    auto olaOutput = std::make_shared<OlaOutput>();
-    std::thread lightThread(lightLoop, meta, olaOutput);
-    std::thread mqttThread(mqttLoop, olaOutput);
+    auto olaOutput = std::make_shared<OlaOutput>(sink, options.patch, options.keepalive * 1e9, options.dither);
+    olaOutput->setFadeTime(options.fadeTime);
+    SDL_Log("Patched %lu fixtures and %lu LED strips",
+            static_cast<unsigned long>(options.patch.fixtures().size()),
+            static_cast<unsigned long>(options.patch.strips().size()));
+    // Connected before the threads start, so both may publish
+    auto mqtt = std::make_shared<MQTT>();
+    mqtt->init();
+
+    if (options.eventLoop) {
+        const int result = eventLoopMain(*source, olaOutput, mqtt, options);
+        if (!sink->close()) {
+            SDL_Log("Could not finish the output.");
+        }
+        return result;
+    }
 
-    switch (options.inputType) {
-    case Options::InputType::DEVICE:
-        return liveMain(std::move(lightThread), meta);
-    case Options::InputType::FILE:
-        return fileMain(std::move(lightThread), meta);
+    // Files are analyzed up front, so replays cost no FFTs at all
+    std::shared_ptr<audio::SpectrumSeries> series;
+    if (!sourceOptions.file.empty() && !options.noCache) {
+        series = loadAnalysis(sourceOptions, source->format());
     }
 
-    assert(false && "This is not the case you are looking for!");
-    return -1;
+    std::thread lightThread(lightLoop, source->format(), source->buffer(), series, olaOutput, sender, mqtt, options);
+    std::thread mqttThread(mqttLoop, mqtt, olaOutput);
+    mqttThread.detach();
+
+    if (source->deliversFromRun()) {
+        rt::applyToCurrentThread("capture", options.capturePolicy);
+    } else if (!options.capturePolicy.isDefault()) {
+        SDL_Log("%s delivers from its own thread, ignoring the capture policy.", source->name().c_str());
+    }
+
+    // Blocks until the source runs dry, which is never for live input
+    const int result = source->run();
+    source->buffer()->close();
+    lightThread.join();
+
+    // The MQTT thread never ends and keeps the sink alive, so it is not
+    // destroyed before exit. Finished here, e.g. for a cue file's index.
+    if (!sink->close()) {
+        SDL_Log("Could not finish the output.");
+    }
+    return result;
 }
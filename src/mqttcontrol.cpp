@@ -1,24 +1,37 @@
 #include "mqttcontrol.h"
 
+#include "eventloop.h"
+
 #include <nlohmann/json.hpp>
 
 #include <SDL_log.h>
 
 #include <errno.h>
+#include <sys/epoll.h>
 
 #include <cassert>
+#include <chrono>
+#include <cstdio>
 #include <sstream>
+#include <thread>
 
 using namespace groggle;
 using json = nlohmann::json;
 
+static const size_t POSTED_METRICS = 64; // Pending at most
+static const int METRICS_POLL_MS = 100; // Publishing delay of posted metrics
+static const std::chrono::seconds RECONNECT_DELAY(1);
+
 void groggle::on_publish(struct mosquitto */*client*/, void *userdata, int mid)
 {
     SDL_Log("Published: %i", mid);
     MQTT *mqtt = reinterpret_cast<MQTT*>(userdata);
     assert(mqtt);
     std::lock_guard<std::mutex> lock(mqtt->m_messagesMutex);
-    mqtt->m_messagesInFlight.erase(mid);
+    if (!mqtt->m_messagesInFlight.erase(mid)) {
+        // Called from within mosquitto_publish(), see publishMessage()
+        mqtt->m_publishedEarly.insert(mid);
+    }
 }
 
 void groggle::on_message(struct mosquitto */*client*/,
@@ -65,6 +78,12 @@ void groggle::on_message(struct mosquitto */*client*/,
         }
     }
 
+    if(const auto brightness = json.find("brightness"); brightness != json.end()) {
+        if(brightness.value().is_number()) {
+            newState.brightness = static_cast<float>(brightness.value()) / 255.0f;
+        }
+    }
+
     if(const auto color = json.find("color"); color != json.end()) {
         const auto colorValue = color.value();
         if(const auto hue = colorValue.find("h"); hue != colorValue.end()) {
@@ -90,6 +109,7 @@ void MQTT::Message::setPayload(const std::string &s)
 }
 
 MQTT::MQTT()
+    : m_postedMetrics(POSTED_METRICS)
 {
     mosquitto_lib_init();
 }
@@ -140,7 +160,68 @@ bool MQTT::init()
 
 void MQTT::run()
 {
-    mosquitto_loop_forever(m_client, -1, 1);
+    if (!m_client) {
+        return;
+    }
+
+    // mosquitto_loop_forever() with a short timeout, to publish posted metrics
+    while (true) {
+        if (mosquitto_loop(m_client, METRICS_POLL_MS, 1) != MOSQ_ERR_SUCCESS) {
+            std::this_thread::sleep_for(RECONNECT_DELAY);
+            mosquitto_reconnect(m_client);
+        }
+        publishPostedMetrics();
+    }
+}
+
+bool MQTT::attach(EventLoop &loop)
+{
+    if (!m_client) {
+        return false;
+    }
+
+    // Nobody runs a network thread, so publishing writes right away
+    mosquitto_threaded_set(m_client, false);
+
+    // Keepalive pings and reconnects
+    const int timer = loop.addTimer(1 /*Hz*/, [this, &loop](const uint64_t) {
+        if (mosquitto_loop_misc(m_client) == MOSQ_ERR_NO_CONN) {
+            mosquitto_reconnect(m_client);
+        }
+        publishPostedMetrics();
+        watchSocket(loop);
+    });
+
+    watchSocket(loop);
+    return timer >= 0;
+}
+
+void MQTT::watchSocket(EventLoop &loop)
+{
+    // Changes with every reconnect
+    const int socket = mosquitto_socket(m_client);
+    if (socket != m_socket) {
+        if (m_socket >= 0) {
+            loop.remove(m_socket);
+        }
+
+        m_socket = socket;
+        if (m_socket >= 0) {
+            loop.add(m_socket, EPOLLIN, [this, &loop](const uint32_t events) {
+                if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                    mosquitto_loop_read(m_client, 1);
+                }
+                if (events & EPOLLOUT) {
+                    mosquitto_loop_write(m_client, 1);
+                }
+                watchSocket(loop);
+            });
+        }
+    }
+
+    if (m_socket >= 0) {
+        loop.modify(m_socket, mosquitto_want_write(m_client) ? EPOLLIN | EPOLLOUT : EPOLLIN);
+    }
 }
 
 void MQTT::publish(const State &state)
@@ -159,10 +240,31 @@ void MQTT::publish(const State &state)
             { "b", Color::f2uint8(state.color.b()) }
         }}
     };
+    if (state.brightness >= 0) {
+        payload["brightness"] = Color::f2uint8(state.brightness);
+    }
     msg->setPayload(payload.dump());
     publishMessage(msg, true);
 }
 
+void MQTT::publishMetric(const std::string &name, const std::string &value)
+{
+    std::shared_ptr<Message> msg = std::make_shared<Message>();
+    msg->topic = TOPIC + "/metrics/" + name;
+    msg->setPayload(value);
+    publishMessage(msg, true);
+}
+
+void MQTT::publishPostedMetrics()
+{
+    Metric metric;
+    while (m_postedMetrics.pop(&metric)) {
+        char value[32];
+        snprintf(value, sizeof(value), "%g", metric.value);
+        publishMetric(metric.name, value);
+    }
+}
+
 void MQTT::publishInfo()
 {
     // The "groggle" part of the topic should ideally be a UUID.
@@ -175,6 +277,7 @@ void MQTT::publishInfo()
         { "schema", "json" },
         { "state_topic", "groggle" },
         { "command_topic", "groggle/set" },
+        { "brightness", true },
         { "rgb", true },
         { "hs", true },
         { "device", {
@@ -191,7 +294,8 @@ void MQTT::publishInfo()
 
 void MQTT::publishMessage(const std::shared_ptr<Message> msg, const bool retain)
 {
-    std::lock_guard<std::mutex> lock(m_messagesMutex);
+    // Not locked: without a network thread, QoS 0 messages are written and
+    // on_publish() called before mosquitto_publish() returns
     int res = mosquitto_publish(m_client,
         &msg->id,
         msg->topic.c_str(),
@@ -201,10 +305,14 @@ void MQTT::publishMessage(const std::shared_ptr<Message> msg, const bool retain)
         retain);
 
     switch(res) {
-    case MOSQ_ERR_SUCCESS:
-        m_messagesInFlight.insert({msg->id, msg});
+    case MOSQ_ERR_SUCCESS: {
+        std::lock_guard<std::mutex> lock(m_messagesMutex);
+        if (!m_publishedEarly.erase(msg->id)) {
+            m_messagesInFlight.insert({msg->id, msg});
+        }
         SDL_Log("MQTT %i << %s: %s", msg->id, msg->topic.c_str(), msg->payload);
         break;
+    }
     default:
         SDL_Log("MQTT <x %i", res);
         break;
@@ -2,11 +2,13 @@
 #define MQTTCONTROL_H
 
 #include "color.h"
+#include "spscqueue.h"
 
 #include <mosquitto.h>
 
 #include <functional>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -14,12 +16,15 @@
 namespace groggle
 {
 
+class EventLoop;
+
 void on_publish(struct mosquitto*, void*, int);
 void on_message(struct mosquitto*, void*, const struct mosquitto_message*);
 
 struct State {
     bool enabled = true;
     Color color;
+    float brightness = -1; // 0-1, negative if not given
 };
 
 class MQTT
@@ -31,8 +36,19 @@ public:
     ~MQTT();
     bool init();
     void run();
+    /// Serves the connection from the event loop's thread instead of run().
+    bool attach(EventLoop &loop);
     void publishInfo();
     void publish(const State &s);
+    /// Retained under groggle/metrics/<name>. Thread safe after init().
+    void publishMetric(const std::string &name, const std::string &value);
+    /**
+     * Like publishMetric() but without locks or allocations, for real time
+     * threads. Only one thread may post, the metrics are published from run()
+     * or the event loop later. @param name A string literal
+     * @return false if too many metrics are pending
+     */
+    bool postMetric(const char *name, const double value) { return m_postedMetrics.push({ name, value }); }
     void setStateCallback(StateCb cb) { m_stateCallback = cb; }
 
 private:
@@ -45,8 +61,15 @@ private:
         void setPayload(const std::string &s);
     };
 
-    MQTT(const MQTT&) {}
+    struct Metric {
+        const char *name = nullptr;
+        double value = 0;
+    };
+
+    MQTT(const MQTT&) = delete;
+    void publishPostedMetrics();
     void publishMessage(const std::shared_ptr<Message> msg, const bool retain = false);
+    void watchSocket(EventLoop &loop);
 
     StateCb m_stateCallback;
     State curState;
@@ -55,8 +78,11 @@ private:
     const std::string TOPIC_SET = TOPIC + "/set";
 
     struct mosquitto *m_client = nullptr;
+    int m_socket = -1; // Watched by the event loop
     std::mutex m_messagesMutex;
     std::unordered_map<int, std::shared_ptr<Message>> m_messagesInFlight;
+    std::unordered_set<int> m_publishedEarly; // Before publishMessage() got the id
+    SpscQueue<Metric> m_postedMetrics;
 
     // Mosquitto library callbacks
     friend void on_publish(struct mosquitto*, void*, int);
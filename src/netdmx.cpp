@@ -0,0 +1,273 @@
+#include "netdmx.h"
+
+#include <SDL_log.h>
+
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <random>
+
+namespace groggle
+{
+namespace net
+{
+
+static const char ARTNET_ID[8] = { 'A', 'r', 't', '-', 'N', 'e', 't', '\0' };
+static const uint16_t OP_DMX = 0x5000;
+static const uint16_t OP_SYNC = 0x5200;
+static const uint8_t ARTNET_VERSION = 14;
+
+static const uint8_t ACN_ID[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', '\0', '\0', '\0' };
+static const uint32_t VECTOR_ROOT_DATA = 0x00000004;
+static const uint32_t VECTOR_ROOT_EXTENDED = 0x00000008;
+static const uint32_t VECTOR_FRAMING_DATA = 0x00000002;
+static const uint32_t VECTOR_EXTENDED_SYNC = 0x00000001;
+static const uint8_t VECTOR_DMP_SET_PROPERTY = 0x02;
+static const uint8_t SACN_PRIORITY = 100;
+static const char SOURCE_NAME[] = "groggle";
+
+bool isValidUniverse(const Protocol protocol, const uint16_t universe)
+{
+    if (protocol == Protocol::ARTNET) {
+        return universe <= ARTNET_LAST_UNIVERSE;
+    }
+    return universe >= SACN_FIRST_UNIVERSE && universe <= SACN_LAST_UNIVERSE;
+}
+
+// Encoding
+// ========
+
+static inline void put16be(uint8_t *p, const uint16_t value)
+{
+    p[0] = value >> 8;
+    p[1] = value & 0xff;
+}
+
+static inline void put32be(uint8_t *p, const uint32_t value)
+{
+    put16be(p, value >> 16);
+    put16be(p + 2, value & 0xffff);
+}
+
+/// PDU flags (0x7) and length, counted from the given offset to the end.
+static inline void putFlagsLength(uint8_t *p, const size_t offset, const size_t size)
+{
+    put16be(p, 0x7000 | (size - offset));
+}
+
+void encodeArtDmx(uint8_t packet[], const uint16_t universe, const uint8_t sequence, const uint8_t channels[])
+{
+    memcpy(packet, ARTNET_ID, sizeof(ARTNET_ID));
+    packet[8] = OP_DMX & 0xff; // The opcode is the only little endian field
+    packet[9] = OP_DMX >> 8;
+    packet[10] = 0;
+    packet[11] = ARTNET_VERSION;
+    packet[12] = sequence;
+    packet[13] = 0; // Physical input port
+    packet[14] = universe & 0xff; // SubUni
+    packet[15] = (universe >> 8) & 0x7f; // Net
+    put16be(&packet[16], UNIVERSE_SIZE);
+    memcpy(&packet[18], channels, UNIVERSE_SIZE);
+}
+
+void encodeArtSync(uint8_t packet[])
+{
+    memcpy(packet, ARTNET_ID, sizeof(ARTNET_ID));
+    packet[8] = OP_SYNC & 0xff;
+    packet[9] = OP_SYNC >> 8;
+    packet[10] = 0;
+    packet[11] = ARTNET_VERSION;
+    packet[12] = 0; // Aux1
+    packet[13] = 0; // Aux2
+}
+
+/// The root layer is the same for all packets but for the vector
+static void encodeRoot(uint8_t packet[], const size_t size, const uint32_t vector, const uint8_t cid[16])
+{
+    put16be(&packet[0], 0x0010); // Preamble size
+    put16be(&packet[2], 0x0000); // Postamble size
+    memcpy(&packet[4], ACN_ID, sizeof(ACN_ID));
+    putFlagsLength(&packet[16], 16, size);
+    put32be(&packet[18], vector);
+    memcpy(&packet[22], cid, 16);
+}
+
+void encodeSacnData(uint8_t packet[], const uint8_t cid[16], const uint16_t universe, const uint8_t sequence,
+                    const uint16_t syncUniverse, const uint8_t channels[])
+{
+    encodeRoot(packet, SACN_DATA_SIZE, VECTOR_ROOT_DATA, cid);
+
+    // Framing layer
+    putFlagsLength(&packet[38], 38, SACN_DATA_SIZE);
+    put32be(&packet[40], VECTOR_FRAMING_DATA);
+    memset(&packet[44], 0, 64);
+    memcpy(&packet[44], SOURCE_NAME, sizeof(SOURCE_NAME));
+    packet[108] = SACN_PRIORITY;
+    put16be(&packet[109], syncUniverse);
+    packet[111] = sequence;
+    packet[112] = 0; // Options
+    put16be(&packet[113], universe);
+
+    // DMP layer
+    putFlagsLength(&packet[115], 115, SACN_DATA_SIZE);
+    packet[117] = VECTOR_DMP_SET_PROPERTY;
+    packet[118] = 0xa1; // Address and data type
+    put16be(&packet[119], 0x0000); // First property address
+    put16be(&packet[121], 0x0001); // Address increment
+    put16be(&packet[123], 1 + UNIVERSE_SIZE);
+    packet[125] = 0; // START code
+    memcpy(&packet[126], channels, UNIVERSE_SIZE);
+}
+
+void encodeSacnSync(uint8_t packet[], const uint8_t cid[16], const uint16_t syncUniverse, const uint8_t sequence)
+{
+    encodeRoot(packet, SACN_SYNC_SIZE, VECTOR_ROOT_EXTENDED, cid);
+
+    putFlagsLength(&packet[38], 38, SACN_SYNC_SIZE);
+    put32be(&packet[40], VECTOR_EXTENDED_SYNC);
+    packet[44] = sequence;
+    put16be(&packet[45], syncUniverse);
+    put16be(&packet[47], 0); // Reserved
+}
+
+// Sender
+// ======
+
+Sender::Sender(const Protocol protocol, const std::string &host, const uint16_t port)
+    : m_protocol(protocol)
+{
+    memset(&m_address, 0, sizeof(m_address));
+    m_address.sin_family = AF_INET;
+    m_address.sin_port = htons(port ? port : protocol == Protocol::ARTNET ? ARTNET_PORT : SACN_PORT);
+    m_address.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+
+    m_unicast = !host.empty();
+    if (m_unicast && inet_pton(AF_INET, host.c_str(), &m_address.sin_addr) != 1) {
+        SDL_Log("Invalid IPv4 address for DMX output: %s", host.c_str());
+        return;
+    }
+
+    std::random_device random;
+    for (uint8_t &byte : m_cid) {
+        byte = random();
+    }
+
+    m_socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (m_socket < 0) {
+        SDL_Log("Cannot create DMX output socket: %s", strerror(errno));
+        return;
+    }
+
+    const int on = 1;
+    if (!m_unicast && protocol == Protocol::ARTNET
+            && setsockopt(m_socket, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on)) != 0) {
+        SDL_Log("Cannot broadcast Art-Net: %s", strerror(errno));
+    }
+}
+
+Sender::~Sender()
+{
+    if (m_socket >= 0) {
+        close(m_socket);
+    }
+}
+
+sockaddr_in Sender::destination(const uint16_t universe) const
+{
+    sockaddr_in address = m_address;
+    if (!m_unicast && m_protocol == Protocol::SACN) {
+        address.sin_addr.s_addr = htonl((239u << 24) | (255u << 16) | universe);
+    }
+    return address;
+}
+
+uint8_t Sender::nextSequence(const uint16_t universe)
+{
+    // Art-Net reserves 0 for "no sequence", sACN just wraps
+    uint8_t &sequence = m_sequences[universe];
+    sequence++;
+    if (sequence == 0 && m_protocol == Protocol::ARTNET) {
+        sequence = 1;
+    }
+    return sequence;
+}
+
+bool Sender::send(const DmxFrame &frame)
+{
+    if (m_socket < 0) {
+        return false;
+    }
+
+    // Receivers only hold back data for a sync if there is more than one
+    // universe to line up. Once there is, every frame ends with a sync, even
+    // if only some of them changed, or receivers in sync mode would wait.
+    const size_t count = frame.universes.size();
+    for (const uint16_t universe : frame.universes) {
+        m_sequences.emplace(universe, 0);
+    }
+    const bool sync = m_sequences.size() > 1;
+    const uint16_t syncUniverse = sync ? m_sequences.begin()->first : 0;
+    const size_t dataSize = m_protocol == Protocol::ARTNET ? ARTDMX_SIZE : SACN_DATA_SIZE;
+    const size_t syncSize = m_protocol == Protocol::ARTNET ? ARTSYNC_SIZE : SACN_SYNC_SIZE;
+    const size_t packets = count + (sync ? 1 : 0);
+
+    m_packets.resize(count * dataSize + syncSize);
+    m_destinations.resize(packets);
+    m_iovecs.resize(packets);
+    m_messages.resize(packets);
+
+    for (size_t i = 0; i < packets; i++) {
+        uint8_t *packet = &m_packets[i * dataSize];
+        size_t size = dataSize;
+        if (i < count) {
+            const uint16_t universe = frame.universes[i];
+            if (m_protocol == Protocol::ARTNET) {
+                encodeArtDmx(packet, universe, nextSequence(universe), frame.data(i));
+            } else {
+                encodeSacnData(packet, m_cid, universe, nextSequence(universe), syncUniverse, frame.data(i));
+            }
+            m_destinations[i] = destination(universe);
+        } else {
+            if (m_protocol == Protocol::ARTNET) {
+                encodeArtSync(packet);
+            } else {
+                encodeSacnSync(packet, m_cid, syncUniverse, m_syncSequence++);
+            }
+            size = syncSize;
+            m_destinations[i] = destination(syncUniverse);
+        }
+
+        m_iovecs[i].iov_base = packet;
+        m_iovecs[i].iov_len = size;
+        memset(&m_messages[i], 0, sizeof(mmsghdr));
+        m_messages[i].msg_hdr.msg_name = &m_destinations[i];
+        m_messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        m_messages[i].msg_hdr.msg_iov = &m_iovecs[i];
+        m_messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // One syscall for the whole frame, unless the kernel stops short
+    size_t sent = 0;
+    while (sent < packets) {
+        const int result = sendmmsg(m_socket, &m_messages[sent], packets - sent, 0);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (!m_failing) {
+                SDL_Log("Sending DMX failed: %s", strerror(errno));
+            }
+            m_failing = true;
+            return false;
+        }
+        sent += result;
+    }
+
+    m_failing = false;
+    return true;
+}
+
+}
+}
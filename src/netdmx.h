@@ -0,0 +1,108 @@
+#ifndef NETDMX_H
+#define NETDMX_H
+
+#include "patch.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace groggle
+{
+
+/**
+ * DMX over UDP without olad in between: Art-Net 4 (ArtDmx, ArtSync) and
+ * E1.31 / sACN (data and universe synchronization packets).
+ */
+namespace net
+{
+
+enum class Protocol
+{
+    ARTNET,
+    SACN
+};
+
+static const uint16_t ARTNET_PORT = 6454;
+static const uint16_t SACN_PORT = 5568;
+
+static const uint16_t ARTNET_LAST_UNIVERSE = 0x7fff; // 15 bit port address
+static const uint16_t SACN_FIRST_UNIVERSE = 1;
+static const uint16_t SACN_LAST_UNIVERSE = 63999;
+
+/// Whether the protocol can address the universe at all.
+bool isValidUniverse(const Protocol protocol, const uint16_t universe);
+
+static const size_t ARTDMX_SIZE = 18 + UNIVERSE_SIZE;
+static const size_t ARTSYNC_SIZE = 14;
+static const size_t SACN_DATA_SIZE = 126 + UNIVERSE_SIZE;
+static const size_t SACN_SYNC_SIZE = 49;
+
+/**
+ * Packet encoders, each fills exactly the size above.
+ * @param universe Art-Net port address (15 bit) or sACN universe (1-63999)
+ * @param sequence 1-255 and wrapping, 0 disables reordering checks
+ */
+void encodeArtDmx(uint8_t packet[], const uint16_t universe, const uint8_t sequence, const uint8_t channels[]);
+void encodeArtSync(uint8_t packet[]);
+/// @param syncUniverse Receivers hold the data until a sync for it, 0 for none
+void encodeSacnData(uint8_t packet[], const uint8_t cid[16], const uint16_t universe, const uint8_t sequence,
+                    const uint16_t syncUniverse, const uint8_t channels[]);
+void encodeSacnSync(uint8_t packet[], const uint8_t cid[16], const uint16_t syncUniverse, const uint8_t sequence);
+
+/**
+ * Sends whole frames in a single sendmmsg(), followed by a sync packet so
+ * receivers switch all universes at once.
+ *
+ * Without a host Art-Net broadcasts and sACN multicasts each universe to its
+ * group (239.255.hi.lo). Universe numbers go out as they are, check them
+ * with isValidUniverse() up front.
+ */
+class Sender
+{
+public:
+    /**
+     * @param host IPv4 address to unicast to, empty for broadcast/multicast
+     * @param port 0 for the protocol's default
+     */
+    Sender(const Protocol protocol, const std::string &host = "", const uint16_t port = 0);
+    ~Sender();
+
+    bool isOpen() const { return m_socket >= 0; }
+
+    /// @return false if any packet could not be sent
+    bool send(const DmxFrame &frame);
+
+private:
+    Sender(const Sender&) = delete;
+    Sender &operator=(const Sender&) = delete;
+
+    sockaddr_in destination(const uint16_t universe) const;
+    uint8_t nextSequence(const uint16_t universe);
+
+    const Protocol m_protocol;
+    int m_socket = -1;
+    bool m_unicast = false;
+    sockaddr_in m_address;
+    uint8_t m_cid[16]; // sACN source id, random per run
+
+    std::map<uint16_t, uint8_t> m_sequences; // Per universe ever sent
+    uint8_t m_syncSequence = 0;
+    bool m_failing = false; // Only log the first of a series of errors
+
+    // Recycled between frames
+    std::vector<uint8_t> m_packets;
+    std::vector<sockaddr_in> m_destinations;
+    std::vector<iovec> m_iovecs;
+    std::vector<mmsghdr> m_messages;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,29 @@
+#include "netsink.h"
+
+#include <algorithm> // fill, min
+
+namespace groggle
+{
+
+NetSink::NetSink(const net::Protocol protocol, const std::string &host, const uint16_t port)
+    : m_sender(protocol, host, port)
+{
+    m_single.universes.resize(1);
+    m_single.channels.resize(UNIVERSE_SIZE);
+}
+
+bool NetSink::send(const unsigned int universe, const ola::DmxBuffer &dmx)
+{
+    m_single.universes[0] = universe;
+    std::fill(m_single.channels.begin(), m_single.channels.end(), 0);
+    unsigned int length = std::min<unsigned int>(dmx.Size(), UNIVERSE_SIZE);
+    dmx.Get(m_single.channels.data(), &length);
+    return m_sender.send(m_single);
+}
+
+bool NetSink::sendFrame(const DmxFrame &frame)
+{
+    return m_sender.send(frame);
+}
+
+}
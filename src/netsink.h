@@ -0,0 +1,32 @@
+#ifndef NETSINK_H
+#define NETSINK_H
+
+#include "dmxsink.h"
+#include "netdmx.h"
+
+#include <string>
+
+namespace groggle
+{
+
+/**
+ * Sends Art-Net or sACN straight from groggle, c.f. net::Sender.
+ */
+class NetSink : public DmxSink
+{
+public:
+    NetSink(const net::Protocol protocol, const std::string &host = "", const uint16_t port = 0);
+
+    bool isOpen() const { return m_sender.isOpen(); }
+
+    bool send(const unsigned int universe, const ola::DmxBuffer &dmx) override;
+    bool sendFrame(const DmxFrame &frame) override;
+
+private:
+    net::Sender m_sender;
+    DmxFrame m_single; // Recycled by send()
+};
+
+}
+
+#endif
@@ -0,0 +1,29 @@
+#include "nullsink.h"
+
+#include <SDL_log.h>
+
+namespace groggle
+{
+
+bool NullSink::send(const unsigned int, const ola::DmxBuffer&)
+{
+    m_frames++;
+    m_universes++;
+    return true;
+}
+
+bool NullSink::sendFrame(const DmxFrame &frame)
+{
+    m_frames++;
+    m_universes += frame.universes.size();
+    return true;
+}
+
+bool NullSink::close()
+{
+    SDL_Log("Discarded %lu frames with %lu universes",
+            static_cast<unsigned long>(m_frames), static_cast<unsigned long>(m_universes));
+    return true;
+}
+
+}
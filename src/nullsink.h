@@ -0,0 +1,33 @@
+#ifndef NULLSINK_H
+#define NULLSINK_H
+
+#include "dmxsink.h"
+
+#include <cstdint>
+
+namespace groggle
+{
+
+/**
+ * Drops everything, for measuring groggle itself without any I/O. Counts
+ * what it got and logs that when done.
+ */
+class NullSink : public DmxSink
+{
+public:
+    uint64_t frames() const { return m_frames; }
+    uint64_t universes() const { return m_universes; }
+
+    bool send(const unsigned int universe, const ola::DmxBuffer &dmx) override;
+    bool sendFrame(const DmxFrame &frame) override;
+    /// Logs the counts.
+    bool close() override;
+
+private:
+    uint64_t m_frames = 0;
+    uint64_t m_universes = 0;
+};
+
+}
+
+#endif
@@ -2,93 +2,180 @@
 
 #include "spectrum.h"
 
-#include <ola/Logging.h>
-#include <ola/client/StreamingClient.h>
-
-#include <SDL_log.h>
-
+#include <algorithm> // copy, max, max_element, min
+#include <chrono>
+#include <cmath>
 #include <deque>
 
 namespace groggle
 {
 
 static const float ORANGE = 18.0f; // TODO Move into Color
-
-OlaOutput::OlaOutput()
-    : m_color(ORANGE, 1.0f, 0.5f)
+static const float DECAY_RATE = 30; // Hz the decay factor below was tuned at
+static const float ONSET_RATIO = 1.5f; // Over the held level
+static const float ONSET_FLOOR = 0.1f;
+
+OlaOutput::OlaOutput(std::shared_ptr<DmxSink> sink, const Patch &patch, const uint64_t keepalive,
+                     const bool dither)
+    : m_sink(sink)
+    , m_filter(keepalive)
+    , m_plan(patch, dither)
+    , m_pixelMap(patch, m_plan)
+    , m_effects(patch)
+    , m_levels(patch.fixtures().size() * level::COUNT, 0)
     , m_magnitudeBuf(64)
 {
-    // turn on OLA logging
-    ola::InitLogging(ola::OLA_LOG_WARN, ola::OLA_LOG_STDERR);
-
-    // Create a new client.
-    m_olaClient = new ola::client::StreamingClient((ola::client::StreamingClient::Options()));
-
-    // Setup the client, this connects to the server
-    if (!m_olaClient->Setup()) {
-        SDL_Log("Setup failed");
-        return;
-    }
-
+    Control control;
+    control.color = Color(ORANGE, 1.0f, 0.5f);
+    control.interval = 1 / DECAY_RATE;
+    m_control.store(control);
+
+    m_rgb[0] = control.color.r();
+    m_rgb[1] = control.color.g();
+    m_rgb[2] = control.color.b();
+    m_fade.start(m_rgb, m_rgb, 0);
     blackout();
 }
 
-Color OlaOutput::color()
+void OlaOutput::setUpdateRate(const float rate)
 {
-    return m_color;
+    // Computed up front, update() may run its function more than once
+    const float decay = std::pow(0.9f, DECAY_RATE / rate);
+    m_control.update([decay, rate](Control &control) {
+        control.decay = decay;
+        control.interval = 1 / rate;
+    });
 }
 
 void OlaOutput::setColor(const Color &color)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_color = color;
+    m_control.update([&color](Control &control) {
+        control.color = color;
+        control.colorChanges++;
+    });
+}
+
+void OlaOutput::setFadeTime(const float seconds)
+{
+    m_control.update([seconds](Control &control) { control.fadeTime = seconds; });
+}
+
+void OlaOutput::setBrightness(const float brightness)
+{
+    m_control.update([brightness](Control &control) {
+        control.brightness = std::min(std::max(brightness, 0.0f), 1.0f);
+    });
 }
 
 void OlaOutput::setEnabled(const bool enabled)
 {
-    if (m_enabled && !enabled) {
+    bool wasEnabled = false;
+    m_control.update([&](Control &control) {
+        wasEnabled = control.enabled;
+        control.enabled = enabled;
+    });
+
+    if (wasEnabled && !enabled) {
         blackout();
     }
-
-    // Lock after blackout, it also acquires a lock!
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_enabled = enabled;
 }
 
 void OlaOutput::blackout()
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_dmx.Blackout();
-    m_olaClient->SendDmx(m_universe, m_dmx);
+    // Not m_frame, that belongs to the render thread
+    send(blackoutFrame());
+}
+
+DmxFrame OlaOutput::blackoutFrame() const
+{
+    DmxFrame frame;
+    frame.universes = m_plan.universes();
+    frame.channels.assign(frame.universes.size() * UNIVERSE_SIZE, 0);
+    return frame;
 }
 
 void OlaOutput::update(const audio::Spectrum spectrum)
 {
-    /* Tripar:
-     * 1-3: RGB
-     * 6: Dimmer
-     */
-
-    std::lock_guard<std::mutex> lock(m_mutex);
-    const float val = spectrum.at(1);
-
-    if (val > m_intensity) {
-        m_intensity = val;
-    } else {
-        m_intensity *= 0.9f;
+    render(spectrum, &m_frame);
+    send(m_frame);
+}
+
+bool OlaOutput::send(const DmxFrame &frame)
+{
+    const uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    // Checked under the lock: a frame rendered before setEnabled(false) that
+    // gets here after its blackout goes out dark as well
+    const bool changed = m_control.load().enabled
+        ? m_filter.apply(frame, now, &m_changed)
+        : m_filter.apply(blackoutFrame(), now, &m_changed);
+    if (!changed) {
+        return true; // Nothing new, and no keepalive due
+    }
+    return m_sink->sendFrame(m_changed);
+}
+
+void OlaOutput::changeStats(uint64_t *sent, uint64_t *skipped)
+{
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    *sent = m_filter.sent();
+    *skipped = m_filter.skipped();
+}
+
+void OlaOutput::render(const audio::Spectrum &spectrum, DmxFrame *frame)
+{
+    // Once per frame object, channels nothing is patched to stay at zero
+    if (frame->universes != m_plan.universes()) {
+        *frame = blackoutFrame();
     }
 
-    m_magnitudeBuf.append(val);
+    const Control control = m_control.load();
+    m_magnitudeBuf.append(spectrum.size() > 1 ? spectrum[1] : 0);
     //const float scale = 0.5 * 1.0 / std::max(m_magnitudeBuf.average(), 0.01f);
     const float scale = 1.0;
 
-    m_dmx.SetChannel(m_adj + 5, Color::f2uint8(m_intensity * scale));
-    m_dmx.SetChannel(m_adj + 0, Color::f2uint8(m_color.r()));
-    m_dmx.SetChannel(m_adj + 1, Color::f2uint8(m_color.g()));
-    m_dmx.SetChannel(m_adj + 2, Color::f2uint8(m_color.b()));
-    if (!m_olaClient->SendDmx(m_universe, m_dmx)) {
-        SDL_Log("SendDmx() failed");
+    EffectInputs inputs;
+    for (size_t r = 0; r < ROLE_COUNT; r++) {
+        size_t first = 0;
+        size_t last = 0;
+        Patch::band(static_cast<Role>(r), &first, &last);
+
+        float val = 0;
+        if (first < spectrum.size()) { // Empty or short spectra count as silence
+            last = std::min(last, spectrum.size() - 1);
+            val = *std::max_element(spectrum.begin() + first, spectrum.begin() + last + 1);
+        }
+
+        inputs.onsets[r] = val > ONSET_FLOOR && val > ONSET_RATIO * m_intensity[r];
+        if (val > m_intensity[r]) {
+            m_intensity[r] = val;
+        } else {
+            m_intensity[r] *= control.decay;
+        }
+    }
+
+    if (control.colorChanges != m_colorChanges) {
+        m_colorChanges = control.colorChanges;
+        const float rgb[3] = { control.color.r(), control.color.g(), control.color.b() };
+        m_fade.start(m_rgb, rgb, control.fadeTime);
+    }
+    m_fade.advance(control.interval, m_rgb);
+    std::copy(m_rgb, m_rgb + 3, inputs.rgb);
+    for (size_t r = 0; r < ROLE_COUNT; r++) {
+        inputs.bands[r] = std::min(m_intensity[r] * scale, 1.0f);
+    }
+    inputs.brightness = control.brightness;
+    m_effects.run(inputs, control.interval, m_levels.data());
+
+    // Strips have no dimmer, the brightness goes into their color
+    float stripRgb[3];
+    for (size_t c = 0; c < 3; c++) {
+        stripRgb[c] = inputs.rgb[c] * control.brightness;
     }
+    m_plan.apply(m_levels.data(), frame->channels.data(), m_frameCount++);
+    m_pixelMap.render(spectrum, stripRgb, inputs.bands, control.decay, frame->channels.data());
 }
 
 }
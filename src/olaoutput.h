@@ -1,40 +1,105 @@
 #ifndef OLAOUTPUT_H
 #define OLAOUTPUT_H
 
+#include "changefilter.h"
 #include "color.h"
+#include "colorfade.h"
+#include "dmxsink.h"
+#include "effects.h"
+#include "patch.h"
+#include "pixelmap.h"
 #include "ringbuffer.h"
+#include "seqlock.h"
 #include "spectrum.h"
 
 #include <ola/DmxBuffer.h>
-#include <ola/client/StreamingClient.h>
 
+#include <memory>
 #include <mutex>
+#include <vector>
 
 namespace groggle
 {
 
+/**
+ * Renders spectra onto the patched fixtures and sends all their universes
+ * once per frame.
+ *
+ * Control threads (MQTT, the pipeline's governor) publish settings through a
+ * Seqlock, render() takes a snapshot of them once per frame without locking.
+ * Everything else render() touches belongs to the thread calling it, one at
+ * a time.
+ */
 class OlaOutput
 {
 public:
-    OlaOutput();
+    /**
+     * @param keepalive ns between sends of unchanged universes, 0 sends
+     * every universe every frame
+     * @param dither Dithers 8 bit channels over time, c.f. ChannelPlan
+     */
+    OlaOutput(std::shared_ptr<DmxSink> sink, const Patch &patch = Patch::builtin(), const uint64_t keepalive = 0,
+              const bool dither = false);
     void blackout();
-    Color color();
+    /// The color faded to, or at.
+    Color color() const { return m_control.load().color; }
+    /// Fades to the color, c.f. setFadeTime().
     void setColor(const Color &color);
-    bool isEnabled() { return m_enabled; }
+    /// s setColor() takes to get there, 0 to switch at once.
+    void setFadeTime(const float seconds);
+    bool isEnabled() const { return m_control.load().enabled; }
     void setEnabled(const bool enabled);
+    float brightness() const { return m_control.load().brightness; }
+    /// Master level over all fixtures and strips, 0-1.
+    void setBrightness(const float brightness);
     void update(const audio::Spectrum spectrum);
 
+    /**
+     * The two halves of update(), for pipelines that send from another
+     * thread: render() computes the next frame, send() passes it to the sink.
+     * @param frame Rendered into. Laid out on first use, keep passing the
+     * same one so frames cost no allocations.
+     */
+    void render(const audio::Spectrum &spectrum, DmxFrame *frame);
+    bool send(const DmxFrame &frame);
+    /// All patched universes at zero.
+    DmxFrame blackoutFrame() const;
+    /// Universes sent and skipped as unchanged so far.
+    void changeStats(uint64_t *sent, uint64_t *skipped);
+    /// How often update() gets called, keeps fades equally long at any rate.
+    void setUpdateRate(const float rate);
+
 private:
-    std::mutex m_mutex;
-    ola::client::StreamingClient *m_olaClient = nullptr;
-    ola::DmxBuffer m_dmx;
-
-    const unsigned int m_universe = 1; // universe to use for sending data
-    const int m_adj = 69;
-    Color m_color;
-    float m_intensity = 0;
+    /// Settings from control threads, as published
+    struct Control
+    {
+        Color color;
+        uint32_t colorChanges = 0; // Starts a fade whenever it counts up
+        float fadeTime = 0; // s
+        float brightness = 1;
+        float decay = 0.9f; // Per update
+        float interval = 1 / 30.0f; // s between updates
+        bool enabled = true;
+    };
+
+    Seqlock<Control> m_control;
+    std::mutex m_sendMutex; // Sinks are not thread safe
+    std::shared_ptr<DmxSink> m_sink;
+    ChangeFilter m_filter; // Under m_sendMutex
+    DmxFrame m_changed;
+    const ChannelPlan m_plan;
+    PixelMap m_pixelMap;
+    EffectEngine m_effects;
+    DmxFrame m_frame; // update()'s
+    uint32_t m_frameCount = 0;
+
+    // Render thread only
+    ColorFade m_fade;
+    uint32_t m_colorChanges = 0; // Seen so far
+    float m_rgb[3] = {}; // On the way to the control color
+    float m_intensity[ROLE_COUNT] = {};
+    std::vector<uint16_t> m_levels; // Per fixture
     RingBuffer<float> m_magnitudeBuf;
-    bool m_enabled = true;
 };
 
 }
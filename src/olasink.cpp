@@ -0,0 +1,35 @@
+#include "olasink.h"
+
+#include <ola/Logging.h>
+#include <ola/client/StreamingClient.h>
+
+#include <SDL_log.h>
+
+namespace groggle
+{
+
+OlaSink::OlaSink()
+{
+    // turn on OLA logging
+    ola::InitLogging(ola::OLA_LOG_WARN, ola::OLA_LOG_STDERR);
+
+    // Create a new client.
+    m_olaClient.reset(new ola::client::StreamingClient((ola::client::StreamingClient::Options())));
+
+    // Setup the client, this connects to the server
+    if (!m_olaClient->Setup()) {
+        SDL_Log("Setup failed");
+    }
+}
+
+bool OlaSink::send(const unsigned int universe, const ola::DmxBuffer &dmx)
+{
+    if (!m_olaClient->SendDmx(universe, dmx)) {
+        SDL_Log("SendDmx() failed");
+        return false;
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,29 @@
+#ifndef OLASINK_H
+#define OLASINK_H
+
+#include "dmxsink.h"
+
+#include <ola/client/StreamingClient.h>
+
+#include <memory>
+
+namespace groggle
+{
+
+/**
+ * Sends to a local olad.
+ */
+class OlaSink : public DmxSink
+{
+public:
+    OlaSink();
+
+    bool send(const unsigned int universe, const ola::DmxBuffer &dmx) override;
+
+private:
+    std::unique_ptr<ola::client::StreamingClient> m_olaClient;
+};
+
+}
+
+#endif
@@ -1,30 +1,121 @@
 #include "painput.h"
 
+#include "eventloop.h"
+
 #include <pulse/context.h>
 #include <pulse/introspect.h>
 #include <pulse/mainloop.h>
 #include <pulse/stream.h>
 
-#include <SDL_audio.h>
 #include <SDL_log.h>
 
+#include <algorithm> // copy_n
+#include <cerrno>
 #include <cmath>
 
 using namespace groggle;
+using namespace groggle::audio::pulse;
+
+static const uint16_t BUFFER_SAMPLES = 1024; // Buffer size in samples
+static const uint8_t CHANNELS = 1;
+static const uint32_t RATE = 44100;
+
+// Sink query
+// ==========
+
+struct SinkQuery
+{
+    audio::pulse::SinkInfoCb cb;
+    std::list<std::string> sinks;
+    pa_mainloop *loop = nullptr;
+};
+
+static void pa_sink_info_cb(pa_context */*ctx*/, const pa_sink_info *info, int eol, void *userdata)
+{
+    SinkQuery *query = reinterpret_cast<SinkQuery *>(userdata);
+    if (info) {
+        query->sinks.push_back(std::string(info->name));
+    }
+
+    if (eol) {
+        query->cb(query->sinks);
+        pa_mainloop_quit(query->loop, 0);
+    }
+}
+
+static void pa_query_notify_cb(pa_context *ctx, void *userdata)
+{
+    SinkQuery *query = reinterpret_cast<SinkQuery *>(userdata);
+    const pa_context_state state = pa_context_get_state(ctx);
+    switch (state) {
+    case PA_CONTEXT_FAILED:
+        SDL_Log("Context state: %i (failed)", state);
+        pa_mainloop_quit(query->loop, -1);
+        break;
+    case PA_CONTEXT_TERMINATED:
+        SDL_Log("Context state: %i (terminated)", state);
+        break;
+    case PA_CONTEXT_READY:
+        pa_operation_unref(pa_context_get_sink_info_list(ctx, &pa_sink_info_cb, userdata));
+        break;
+    default:
+        break;
+    }
+}
+
+int audio::pulse::getSinks(audio::pulse::SinkInfoCb cb)
+{
+    SinkQuery query;
+    query.cb = cb;
+    query.loop = pa_mainloop_new();
+    pa_context *ctx = pa_context_new(pa_mainloop_get_api(query.loop), "groggle");
+    pa_context_set_state_callback(ctx, &pa_query_notify_cb, &query);
 
-// We're dealing with C API here, just accept global variables...
-static enum class Purpose {
-    RECORD,
-    QUERY_SINKS
-} purpose;
-static pa_mainloop *loop;
+    int retval = -1;
+    if (pa_context_connect(ctx, nullptr, PA_CONTEXT_NOFLAGS, nullptr) < 0) {
+        SDL_Log("Connection to PulseAudio failed");
+    } else {
+        pa_mainloop_run(query.loop, &retval);
+        pa_context_disconnect(ctx);
+    }
+
+    pa_context_unref(ctx);
+    pa_mainloop_free(query.loop);
+    return retval;
+}
 
-static void pa_stream_notify_cb(pa_stream *stream, void* /*userdata*/)
+// MonitorSource
+// =============
+
+MonitorSource::MonitorSource(const std::string &device)
+    : m_device(device)
+{}
+
+MonitorSource::~MonitorSource()
 {
+    if (m_stream) {
+        pa_stream_disconnect(m_stream);
+        pa_stream_unref(m_stream);
+    }
+
+    if (m_context) {
+        pa_context_disconnect(m_context);
+        pa_context_unref(m_context);
+    }
+
+    if (m_loop) {
+        pa_mainloop_free(m_loop);
+    }
+}
+
+void MonitorSource::streamNotify(pa_stream *stream, void *userdata)
+{
+    MonitorSource *source = reinterpret_cast<MonitorSource *>(userdata);
     const pa_stream_state state = pa_stream_get_state(stream);
     switch (state) {
     case PA_STREAM_FAILED:
         SDL_Log("Stream state: %i (failed)", state);
+        pa_mainloop_quit(source->m_loop, -1);
         break;
     case PA_STREAM_TERMINATED:
         SDL_Log("Stream state: %i (terminated)", state);
@@ -34,13 +125,13 @@ static void pa_stream_notify_cb(pa_stream *stream, void* /*userdata*/)
     }
 }
 
-static void pa_stream_read_cb(pa_stream *stream, const size_t /*nbytes*/, void *userdata)
+void MonitorSource::streamRead(pa_stream *stream, const size_t /*nbytes*/, void *userdata)
 {
     // Careful when to pa_stream_peek() and pa_stream_drop()!
     // c.f. https://www.freedesktop.org/software/pulseaudio/doxygen/stream_8h.html#ac2838c449cde56e169224d7fe3d00824
-    uint8_t *samples = nullptr;
+    const void *samples = nullptr;
     size_t actualbytes = 0;
-    if (pa_stream_peek(stream, (const void**)&samples, &actualbytes) != 0) {
+    if (pa_stream_peek(stream, &samples, &actualbytes) != 0) {
         SDL_Log("Failed to peek at stream data");
         return;
     }
@@ -52,143 +143,129 @@ static void pa_stream_read_cb(pa_stream *stream, const size_t /*nbytes*/, void *
         // Hole in the buffer. We must drop it.
         if (pa_stream_drop(stream) != 0) {
             SDL_Log("Failed to drop a hole! (Sounds weird, doesn't it?)");
-            return;
         }
+        return;
     }
 
     // Process data
     //SDL_Log(">> %i bytes", actualbytes);
-    AudioMetadata *meta = reinterpret_cast<AudioMetadata *>(userdata);
-    {
-        // TODO What if we're getting too few bytes to fill the buffer?
-        std::lock_guard<std::mutex>(meta->mutex);
-        memcpy(meta->data, samples, std::min(actualbytes, (size_t)meta->fileSpec.samples * 2));
-        meta->dataSize = actualbytes;
-        meta->position = 0;
-    }
+    MonitorSource *source = reinterpret_cast<MonitorSource *>(userdata);
+    const size_t frameSize = sizeof(int16_t) * source->format().channels;
+    source->deliver(reinterpret_cast<const int16_t *>(samples), actualbytes / frameSize);
 
     if (pa_stream_drop(stream) != 0) {
         SDL_Log("Failed to drop data after peeking.");
     }
 }
 
-static void pa_server_info_cb(pa_context *ctx, const pa_server_info */*info*/, void *userdata)
+void MonitorSource::contextNotify(pa_context *ctx, void *userdata)
 {
-    //SDL_Log("Default sink: %s", info->default_sink_name);
-
-    const uint16_t BUFFER_SAMPLES = 1024; // Buffer size in samples
-    const uint8_t CHANNELS = 1;
-    const uint32_t RATE = 44100;
+    MonitorSource *source = reinterpret_cast<MonitorSource *>(userdata);
+    const pa_context_state state = pa_context_get_state(ctx);
+    switch (state) {
+    case PA_CONTEXT_FAILED:
+        SDL_Log("Context state: %i (failed)", state);
+        pa_mainloop_quit(source->m_loop, -1);
+        return;
+    case PA_CONTEXT_TERMINATED:
+        SDL_Log("Context state: %i (terminated)", state);
+        return;
+    case PA_CONTEXT_READY:
+        break;
+    default:
+        return;
+    }
 
     // Set up stream parameters
     pa_sample_spec paSpec;
     paSpec.channels = CHANNELS;
     paSpec.format = PA_SAMPLE_S16LE;
     paSpec.rate = RATE;
-    pa_stream *stream = pa_stream_new(ctx, "output monitor", &paSpec, nullptr);
-
-    // Note stream parameters for later use
-    // TODO Have SDL spec pre-filled by caller
-    AudioMetadata *meta = reinterpret_cast<AudioMetadata *>(userdata);
-    SDL_AudioSpec sdlSpec;
-    SDL_zero(sdlSpec);
-    sdlSpec.channels = CHANNELS;
-    sdlSpec.format = AUDIO_S16LSB;
-    sdlSpec.samples = BUFFER_SAMPLES;
-    sdlSpec.freq = RATE;
-    meta->fileSpec = sdlSpec;
-    meta->duration = 0; // infinity
-    meta->data = new uint8_t[BUFFER_SAMPLES * 2];
-
-    pa_stream_set_state_callback(stream, &pa_stream_notify_cb, userdata);
-    pa_stream_set_read_callback(stream, &pa_stream_read_cb, userdata);
-
-    if (pa_stream_connect_record(stream, meta->audioDevice.c_str(), nullptr, PA_STREAM_NOFLAGS) != 0) {
-        SDL_Log("PulseAudio failed to connect to \"%s\" for recording", meta->audioDevice.c_str());
-        return;
-    }
+    source->m_stream = pa_stream_new(ctx, "output monitor", &paSpec, nullptr);
 
-    //SDL_Log("Connected to %s", meta->inputName.c_str());
-}
+    pa_stream_set_state_callback(source->m_stream, &MonitorSource::streamNotify, userdata);
+    pa_stream_set_read_callback(source->m_stream, &MonitorSource::streamRead, userdata);
 
-struct SinkInfoContainer
-{
-    audio::pulse::SinkInfoCb cb;
-    std::list<std::string> sinks;
-};
+    // Ask for chunks of one analysis window, otherwise PA picks something huge.
+    pa_buffer_attr attr;
+    attr.maxlength = static_cast<uint32_t>(-1);
+    attr.tlength = static_cast<uint32_t>(-1);
+    attr.prebuf = static_cast<uint32_t>(-1);
+    attr.minreq = static_cast<uint32_t>(-1);
+    attr.fragsize = BUFFER_SAMPLES * CHANNELS * sizeof(int16_t);
 
-static void pa_sink_info_cb(pa_context */*ctx*/, const pa_sink_info *info, int eol, void *userdata)
-{
-    SinkInfoContainer *sic = reinterpret_cast<SinkInfoContainer *>(userdata);
-    if (info) {
-        sic->sinks.push_back(std::string(info->name));
+    if (pa_stream_connect_record(source->m_stream, source->m_device.c_str(), &attr, PA_STREAM_ADJUST_LATENCY) != 0) {
+        SDL_Log("PulseAudio failed to connect to \"%s\" for recording", source->m_device.c_str());
+        pa_mainloop_quit(source->m_loop, -1);
+        return;
     }
 
-    if (eol) {
-        sic->cb(sic->sinks);
-        delete sic;
-    }
+    //SDL_Log("Connected to %s", source->m_device.c_str());
 }
 
-static void pa_context_notify_cb(pa_context *ctx, void *userdata)
+bool MonitorSource::open()
 {
-    const pa_context_state state = pa_context_get_state(ctx);
-    switch (state) {
-    case PA_CONTEXT_FAILED:
-        SDL_Log("Context state: %i (failed)", state);
-        break;
-    case PA_CONTEXT_TERMINATED:
-        SDL_Log("Context state: %i (terminated)", state);
-        break;
-    case PA_CONTEXT_READY:
-        switch(purpose) {
-        case Purpose::QUERY_SINKS:
-            pa_context_get_sink_info_list(ctx, &pa_sink_info_cb, userdata);
-            break;
-        case Purpose::RECORD:
-            pa_context_get_server_info(ctx, &pa_server_info_cb, userdata);
-            break;
-        }
-        break;
-    default:
-        break;
-    }
-}
-
-static int internalMain(void *userdata)
-{
-    loop = pa_mainloop_new();
-    pa_context *ctx = pa_context_new(pa_mainloop_get_api(loop), "groggle");
-    pa_context_set_state_callback(ctx, &pa_context_notify_cb, userdata);
-    if (pa_context_connect(ctx, nullptr, PA_CONTEXT_NOFLAGS, nullptr) < 0) {
+    m_loop = pa_mainloop_new();
+    m_context = pa_context_new(pa_mainloop_get_api(m_loop), "groggle");
+    pa_context_set_state_callback(m_context, &MonitorSource::contextNotify, this);
+    if (pa_context_connect(m_context, nullptr, PA_CONTEXT_NOFLAGS, nullptr) < 0) {
         SDL_Log("Connection to PulseAudio failed");
-        return -1;
+        return false;
     }
 
-    pa_mainloop_run(loop, nullptr);
+    // The stream is only created once the context is ready, but its
+    // parameters are fixed anyway.
+    Format format;
+    format.rate = RATE;
+    format.channels = CHANNELS;
+    format.latency = BUFFER_SAMPLES / static_cast<float>(RATE);
+    format.duration = 0; // infinity
+    setFormat(format);
+    return true;
+}
 
-    // The main loop is probably never going to return. Undead code ahead.
-    // pa_stream_disconnect(..)
-    pa_context_disconnect(ctx);
-    pa_mainloop_free(loop);
-    return 0;
+int MonitorSource::run()
+{
+    int retval = 0;
+    pa_mainloop_run(m_loop, &retval);
+    return retval;
 }
 
-int audio::pulse::getSinks(audio::pulse::SinkInfoCb cb)
+bool MonitorSource::attach(EventLoop &loop)
 {
-    purpose = Purpose::QUERY_SINKS;
-    SinkInfoContainer *sic = new SinkInfoContainer(); // Deleted after calling cb.
-    sic->cb = cb;
-    return internalMain(sic);
+    m_eventLoop = &loop;
+    pa_mainloop_set_poll_func(m_loop, &MonitorSource::poll, this);
+    return true;
 }
 
-int audio::pulse::run(AudioMetadataPtr metadata)
+int MonitorSource::poll(struct pollfd *fds, unsigned long count, int timeout, void *userdata)
 {
-    purpose = Purpose::RECORD;
-    return internalMain(metadata.get());
+    // One poll() for PulseAudio's descriptors and the epoll set
+    MonitorSource *source = static_cast<MonitorSource*>(userdata);
+    std::vector<struct pollfd> &all = source->m_pollFds;
+    all.assign(fds, fds + count);
+    all.push_back({ source->m_eventLoop->fd(), POLLIN, 0 });
+
+    int result = 0;
+    do {
+        result = ::poll(all.data(), all.size(), timeout);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0) {
+        return result;
+    }
+
+    std::copy_n(all.begin(), count, fds);
+    if (all.back().revents & POLLIN) {
+        source->m_eventLoop->dispatch();
+        result--;
+    }
+
+    return result; // PulseAudio's ready descriptors only
 }
 
-void audio::pulse::quit(int retval)
+void MonitorSource::stop()
 {
-    pa_mainloop_quit(loop, retval);
+    // Wakes up the loop as well, so this is fine from other threads.
+    pa_mainloop_quit(m_loop, 0);
 }
@@ -1,10 +1,18 @@
 #ifndef PAINPUT
 #define PAINPUT
 
-#include "audiometadata.h"
+#include "audiosource.h"
+
+#include <poll.h>
 
 #include <functional>
 #include <list>
+#include <string>
+#include <vector>
+
+struct pa_context;
+struct pa_mainloop;
+struct pa_stream;
 
 namespace groggle
 {
@@ -15,9 +23,41 @@ namespace pulse
 
 typedef std::function<void(std::list<std::string>)> SinkInfoCb;
 
+/**
+ * Queries the available sinks. Blocks until cb has been called.
+ */
 int getSinks(audio::pulse::SinkInfoCb cb);
-int run(AudioMetadataPtr metadata);
-void quit(int retval);
+
+/**
+ * Records from a PulseAudio source, usually the monitor of a sink.
+ * run() blocks in the PulseAudio main loop.
+ */
+class MonitorSource : public AudioSource
+{
+public:
+    MonitorSource(const std::string &device);
+    ~MonitorSource();
+
+    bool open() override;
+    int run() override;
+    void stop() override;
+    std::string name() const override { return "PulseAudio \"" + m_device + "\""; }
+    bool attach(EventLoop &loop) override;
+
+private:
+    static int poll(struct pollfd *fds, unsigned long count, int timeout, void *userdata);
+    static void contextNotify(pa_context *ctx, void *userdata);
+    static void streamNotify(pa_stream *stream, void *userdata);
+    static void streamRead(pa_stream *stream, const size_t nbytes, void *userdata);
+
+    const std::string m_device;
+    pa_mainloop *m_loop = nullptr;
+    pa_context *m_context = nullptr;
+    pa_stream *m_stream = nullptr;
+
+    EventLoop *m_eventLoop = nullptr;
+    std::vector<struct pollfd> m_pollFds; // PulseAudio's plus the event loop's
+};
 
 }
 }
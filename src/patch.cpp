@@ -0,0 +1,394 @@
+#include "patch.h"
+
+#include <SDL_log.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm> // any_of, sort, min
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+using json = nlohmann::json;
+
+namespace groggle
+{
+
+static const char *ROLE_NAMES[] = { "bass", "mid", "treble" };
+
+Patch::Patch(const ProfileLibrary &profiles)
+    : m_profiles(profiles)
+{}
+
+Patch Patch::builtin(const ProfileLibrary &profiles)
+{
+    Patch patch(profiles);
+    patch.add(1, 70, "tripar", Role::BASS);
+    return patch;
+}
+
+bool Patch::parseRole(const std::string &name, Role *role)
+{
+    for (size_t i = 0; i < static_cast<size_t>(Role::COUNT); i++) {
+        if (name == ROLE_NAMES[i]) {
+            *role = static_cast<Role>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string Patch::roleName(const Role role)
+{
+    return ROLE_NAMES[static_cast<size_t>(role)];
+}
+
+void Patch::band(const Role role, size_t *first, size_t *last)
+{
+    // At 44.1 kHz and 1024 frames a bin is 43 Hz wide. Bass is the single bin
+    // the Tripar always reacted to.
+    switch (role) {
+    case Role::BASS:
+        *first = 1;
+        *last = 1;
+        break;
+    case Role::MID:
+        *first = 2;
+        *last = 23;
+        break;
+    default:
+        *first = 24;
+        *last = 127;
+        break;
+    }
+}
+
+bool Patch::add(const uint16_t universe, const uint16_t address, const std::string &profile, const Role role,
+                const std::string &group)
+{
+    const size_t index = m_profiles.indexOf(profile);
+    if (index == SIZE_MAX) {
+        SDL_Log("Patch: unknown fixture type '%s'", profile.c_str());
+        return false;
+    }
+
+    if (address < 1 || address + m_profiles.at(index).channels.size() - 1 > UNIVERSE_SIZE) {
+        SDL_Log("Patch: %s at %u.%u does not fit into the universe", profile.c_str(), universe, address);
+        return false;
+    }
+
+    Fixture fixture;
+    fixture.universe = universe;
+    fixture.address = address;
+    fixture.profile = index;
+    fixture.role = role;
+    fixture.group = group.empty() ? roleName(role) : group;
+    m_fixtures.push_back(fixture);
+    return true;
+}
+
+void Patch::setEffects(const std::string &group, const std::vector<Effect> &effects)
+{
+    m_effects[group] = effects;
+}
+
+uint16_t Patch::Strip::lastUniverse() const
+{
+    // Pixels never straddle two universes
+    const uint32_t first = (UNIVERSE_SIZE - (address - 1)) / 3;
+    if (pixels <= first) {
+        return universe;
+    }
+    return universe + (pixels - first + 169) / 170;
+}
+
+bool Patch::addStrip(const Strip &strip)
+{
+    if (strip.address < 1 || strip.address + 2u > UNIVERSE_SIZE || strip.pixels == 0
+            || strip.universe + static_cast<uint32_t>(strip.pixels / 170 + 1) > UINT16_MAX) {
+        SDL_Log("Patch: strip of %u pixels at %u.%u does not fit", strip.pixels, strip.universe, strip.address);
+        return false;
+    }
+
+    m_strips.push_back(strip);
+    return true;
+}
+
+static bool parseEffect(const json &entry, Effect *effect)
+{
+    Effect::Type type = Effect::Type::BAND;
+    const json typeName = entry.is_object() ? entry.value("type", json()) : json();
+    if (!typeName.is_string() || !Effect::parseType(typeName, &type)) {
+        SDL_Log("Patch: effects need a known type: %s", entry.dump().c_str());
+        return false;
+    }
+
+    *effect = Effect::defaults(type);
+    effect->depth = entry.value("depth", effect->depth);
+    effect->rate = entry.value("rate", effect->rate);
+    effect->length = entry.value("length", effect->length);
+    effect->width = entry.value("width", effect->width);
+    effect->spread = entry.value("spread", effect->spread);
+    if (effect->width <= 0 || effect->length < 0) {
+        SDL_Log("Patch: effect width and length must be positive: %s", entry.dump().c_str());
+        return false;
+    }
+
+    if (entry.contains("role")) {
+        const std::string role = entry.value("role", std::string());
+        if (!Patch::parseRole(role, &effect->role)) {
+            SDL_Log("Patch: unknown role '%s'", role.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parseStrip(const json &entry, Patch::Strip *strip)
+{
+    if (!entry.is_object()
+            || !entry.value("universe", json()).is_number_unsigned()
+            || !entry.value("address", json()).is_number_unsigned()
+            || !entry.value("pixels", json()).is_number_unsigned()) {
+        SDL_Log("Patch: strips need a universe, an address and a pixel count: %s", entry.dump().c_str());
+        return false;
+    }
+
+    const unsigned int universe = entry["universe"];
+    const unsigned int address = entry["address"];
+    if (universe > UINT16_MAX || address > UNIVERSE_SIZE) {
+        SDL_Log("Patch: %u.%u is out of range", universe, address);
+        return false;
+    }
+    strip->universe = universe;
+    strip->address = address;
+    strip->pixels = entry["pixels"];
+    strip->gain = entry.value("gain", 1.0f);
+    strip->rainbow = entry.value("rainbow", false);
+
+    const std::string mode = entry.value("mode", std::string("bars"));
+    if (mode == "bars") {
+        strip->mode = Patch::Strip::Mode::BARS;
+    } else if (mode == "vu") {
+        strip->mode = Patch::Strip::Mode::VU;
+    } else {
+        SDL_Log("Patch: unknown strip mode '%s'", mode.c_str());
+        return false;
+    }
+
+    const std::string role = entry.value("role", std::string(ROLE_NAMES[0]));
+    if (!Patch::parseRole(role, &strip->role)) {
+        SDL_Log("Patch: unknown role '%s'", role.c_str());
+        return false;
+    }
+
+    const std::string order = entry.value("order", std::string("rgb"));
+    const std::string components = "rgb";
+    for (size_t c = 0; c < 3; c++) {
+        const size_t offset = order.find(components[c]);
+        if (order.size() != 3 || offset == std::string::npos) {
+            SDL_Log("Patch: invalid color order '%s'", order.c_str());
+            return false;
+        }
+        strip->order[c] = offset;
+    }
+    return true;
+}
+
+bool Patch::load(const std::string &path, const ProfileLibrary &profiles, Patch *patch)
+{
+    std::ifstream file(path);
+    if (!file) {
+        SDL_Log("Patch: could not open %s", path.c_str());
+        return false;
+    }
+
+    std::stringstream text;
+    text << file.rdbuf();
+    return parse(text.str(), profiles, patch);
+}
+
+bool Patch::parse(const std::string &text, const ProfileLibrary &profiles, Patch *patch)
+{
+    const json root = json::parse(text, nullptr, false);
+    if (root.is_discarded() || !root.is_object()) {
+        SDL_Log("Patch: not a JSON object");
+        return false;
+    }
+
+    const json fixtures = root.value("fixtures", json());
+    const json strips = root.value("strips", json());
+    if ((fixtures.is_null() && strips.is_null())
+            || (!fixtures.is_null() && !fixtures.is_array())
+            || (!strips.is_null() && !strips.is_array())) {
+        SDL_Log("Patch: expected a fixtures and/or a strips array");
+        return false;
+    }
+
+    Patch result(profiles);
+    for (const json &entry : fixtures) { // null iterates as empty
+        if (!entry.is_object()
+                || !entry.value("universe", json()).is_number_unsigned()
+                || !entry.value("address", json()).is_number_unsigned()
+                || !entry.value("type", json()).is_string()) {
+            SDL_Log("Patch: fixtures need a universe, an address and a type: %s", entry.dump().c_str());
+            return false;
+        }
+
+        const unsigned int universe = entry["universe"];
+        const unsigned int address = entry["address"];
+        const std::string type = entry["type"];
+
+        Role role = Role::BASS;
+        const std::string roleName = entry.value("role", std::string(ROLE_NAMES[0]));
+        if (!parseRole(roleName, &role)) {
+            SDL_Log("Patch: unknown role '%s'", roleName.c_str());
+            return false;
+        }
+
+        const std::string group = entry.value("group", std::string());
+        const unsigned int count = entry.value("count", 1u);
+        if (universe > UINT16_MAX || address > UNIVERSE_SIZE) {
+            SDL_Log("Patch: %u.%u is out of range", universe, address);
+            return false;
+        }
+
+        unsigned int next = address;
+        for (unsigned int i = 0; i < count; i++) {
+            if (!result.add(universe, next, type, role, group)) {
+                return false;
+            }
+            next += profiles.at(result.m_fixtures.back().profile).channels.size();
+        }
+    }
+
+    const json effects = root.value("effects", json::object());
+    if (!effects.is_object()) {
+        SDL_Log("Patch: expected effect chains by group");
+        return false;
+    }
+    for (const auto &chain : effects.items()) {
+        const bool known = std::any_of(result.m_fixtures.begin(), result.m_fixtures.end(),
+                                       [&](const Fixture &fixture) { return fixture.group == chain.key(); });
+        if (!known || !chain.value().is_array()) {
+            SDL_Log("Patch: effects need a list and a group with fixtures: %s", chain.key().c_str());
+            return false;
+        }
+
+        std::vector<Effect> chainEffects;
+        for (const json &entry : chain.value()) {
+            Effect effect;
+            if (!parseEffect(entry, &effect)) {
+                return false;
+            }
+            chainEffects.push_back(effect);
+        }
+        result.setEffects(chain.key(), chainEffects);
+    }
+
+    for (const json &entry : strips) {
+        Strip strip;
+        if (!parseStrip(entry, &strip) || !result.addStrip(strip)) {
+            return false;
+        }
+    }
+
+    *patch = result;
+    return true;
+}
+
+// ChannelPlan
+// ===========
+
+// Response curves have a point every 16 levels, and one past the end
+static const uint32_t CURVE_SHIFT = 4;
+static const uint32_t CURVE_SIZE = (1 << (16 - CURVE_SHIFT)) + 1;
+static const uint32_t CURVE_FRACTION = (1 << CURVE_SHIFT) - 1;
+
+// Offsets of the low byte, 8 frames in bit reversed order, averaging to half
+static const uint8_t DITHER[8] = { 16, 144, 80, 208, 48, 176, 112, 240 };
+
+ChannelPlan::ChannelPlan(const Patch &patch, const bool dither)
+{
+    for (const Patch::Fixture &fixture : patch.fixtures()) {
+        m_universes.push_back(fixture.universe);
+    }
+    for (const Patch::Strip &strip : patch.strips()) {
+        for (uint32_t universe = strip.universe; universe <= strip.lastUniverse(); universe++) {
+            m_universes.push_back(universe);
+        }
+    }
+    std::sort(m_universes.begin(), m_universes.end());
+    m_universes.erase(std::unique(m_universes.begin(), m_universes.end()), m_universes.end());
+
+    std::map<float, uint32_t> curves; // Offsets by gamma
+    for (size_t f = 0; f < patch.fixtures().size(); f++) {
+        const Patch::Fixture &fixture = patch.fixtures()[f];
+        const FixtureProfile &profile = patch.profiles().at(fixture.profile);
+        const size_t slot = std::lower_bound(m_universes.begin(), m_universes.end(), fixture.universe) - m_universes.begin();
+        const uint32_t base = slot * UNIVERSE_SIZE + fixture.address - 1;
+
+        // Fixtures without a dimmer get the color pre-dimmed instead
+        const bool hasDimmer = profile.has(Function::DIMMER);
+        const uint32_t levels = f * level::COUNT;
+
+        // One curve per gamma. The linear one comes out exact.
+        auto curve = curves.find(profile.gamma);
+        if (curve == curves.end()) {
+            curve = curves.emplace(profile.gamma, m_curves.size()).first;
+            for (uint32_t i = 0; i < CURVE_SIZE; i++) {
+                const double x = i / static_cast<double>(CURVE_SIZE - 1);
+                m_curves.push_back(std::round(std::pow(x, profile.gamma) * (UINT16_MAX + 1)));
+            }
+        }
+
+        for (size_t i = 0; i < profile.channels.size(); i++) {
+            const ProfileChannel &channel = profile.channels[i];
+            if (channel.function == Function::NONE) {
+                continue;
+            }
+
+            Write write;
+            write.channel = base + i;
+            if (channel.value >= 0) {
+                // Masked to level 0 of a flat curve, so it sorts in with the rest
+                const uint32_t value = (channel.fine ? channel.value & 0xff : channel.value >> 8) << 8;
+                write.level = levels;
+                write.mask = 0;
+                write.curve = m_curves.size();
+                m_curves.push_back(value);
+                m_curves.push_back(value);
+                m_writes.push_back(write);
+                continue;
+            }
+
+            write.curve = curve->second;
+            write.shift = channel.fine ? 0 : 8;
+            write.dither = dither && !channel.fine && !profile.hasFine(channel.function) ? 0xff : 0;
+            if (channel.function == Function::DIMMER) {
+                write.level = levels + level::INTENSITY;
+            } else if (hasDimmer) {
+                write.level = levels + level::plain(channel.function);
+            } else {
+                write.level = levels + level::dimmed(channel.function);
+            }
+            m_writes.push_back(write);
+        }
+    }
+
+    // Overlapping fixtures: the one patched last wins, as with any console
+    std::stable_sort(m_writes.begin(), m_writes.end(), [](const Write &a, const Write &b) { return a.channel < b.channel; });
+}
+
+void ChannelPlan::apply(const uint16_t levels[], uint8_t channels[], const uint32_t frame) const
+{
+    for (const Write &write : m_writes) {
+        const uint32_t level = levels[write.level] & write.mask;
+        const uint32_t *curve = &m_curves[write.curve + (level >> CURVE_SHIFT)];
+        const uint32_t corrected = curve[0] + (((curve[1] - curve[0]) * (level & CURVE_FRACTION)) >> CURVE_SHIFT);
+        const uint32_t offset = DITHER[(frame + write.channel) & 7] & write.dither;
+        channels[write.channel] = std::min<uint32_t>(corrected + offset, UINT16_MAX) >> write.shift;
+    }
+}
+
+}
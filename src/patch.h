@@ -0,0 +1,166 @@
+#ifndef PATCH_H
+#define PATCH_H
+
+#include "effects.h"
+#include "fixtures.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace groggle
+{
+
+static const size_t UNIVERSE_SIZE = 512;
+
+/**
+ * All patched universes of one rendered frame, their channels back to back.
+ */
+struct DmxFrame
+{
+    std::vector<uint16_t> universes;
+    std::vector<uint8_t> channels; // UNIVERSE_SIZE per universe
+
+    const uint8_t *data(const size_t index) const { return &channels[index * UNIVERSE_SIZE]; }
+};
+
+/**
+ * Which fixtures are where: a list of (universe, start address, fixture
+ * profile, role, group), and the effects of each group. Loaded once at
+ * startup, c.f. ChannelPlan and EffectEngine for the per frame side.
+ *
+ * File format (JSON):
+ *   { "fixtures": [ { "universe": 1, "address": 70, "type": "tripar",
+ *                     "role": "bass", "group": "front", "count": 1 }, ... ],
+ *     "effects": { "front": [ { "type": "band" },
+ *                             { "type": "chase", "rate": 2, "depth": 0.5 } ] },
+ *     "strips": [ { "universe": 10, "address": 1, "pixels": 300, "mode": "bars",
+ *                   "order": "grb", "gain": 4, "rainbow": true }, ... ] }
+ * Types are ProfileLibrary names. Addresses start at 1, "role" defaults to
+ * bass, "group" to the role's name, "count" patches that many fixtures back
+ * to back.
+ *
+ * Effects take the fields of Effect by name. Groups without a chain follow
+ * their fixtures' roles.
+ *
+ * Strips are RGB pixels, c.f. PixelMap. They continue in the following
+ * universes, which hold 170 pixels each. "bars" spreads the spectrum over the
+ * strip, "vu" fills it up to the role's level.
+ */
+class Patch
+{
+public:
+    struct Fixture
+    {
+        uint16_t universe = 0;
+        uint16_t address = 0; // 1-512
+        size_t profile = 0; // Index into profiles()
+        Role role = Role::BASS;
+        std::string group;
+    };
+
+    struct Strip
+    {
+        enum class Mode { BARS, VU };
+
+        uint16_t universe = 0;
+        uint16_t address = 0; // 1-510
+        uint32_t pixels = 0;
+        Mode mode = Mode::BARS;
+        Role role = Role::BASS; // VU meters only
+        uint8_t order[3] = { 0, 1, 2 }; // Offsets of red, green and blue
+        float gain = 1;
+        bool rainbow = false; // Hue along the strip instead of the color
+
+        /// The universe holding the last pixel
+        uint16_t lastUniverse() const;
+    };
+
+    Patch(const ProfileLibrary &profiles = ProfileLibrary::builtin());
+
+    /// The single Tripar on universe 1 groggle was built around.
+    static Patch builtin(const ProfileLibrary &profiles = ProfileLibrary::builtin());
+
+    static bool load(const std::string &path, const ProfileLibrary &profiles, Patch *patch);
+    static bool parse(const std::string &text, const ProfileLibrary &profiles, Patch *patch);
+
+    /**
+     * @param group Empty for the role's name
+     * @return false (and logs why) if the profile is unknown or it does not fit
+     */
+    bool add(const uint16_t universe, const uint16_t address, const std::string &profile, const Role role,
+             const std::string &group = "");
+
+    /// Replaces the group's effect chain.
+    void setEffects(const std::string &group, const std::vector<Effect> &effects);
+
+    /// @return false (and logs why) if it does not fit
+    bool addStrip(const Strip &strip);
+
+    const std::vector<Fixture> &fixtures() const { return m_fixtures; }
+    const std::vector<Strip> &strips() const { return m_strips; }
+    const std::map<std::string, std::vector<Effect>> &effects() const { return m_effects; }
+    const ProfileLibrary &profiles() const { return m_profiles; }
+    static bool parseRole(const std::string &name, Role *role);
+    static std::string roleName(const Role role);
+
+    /// Spectrum bins (inclusive) a role's intensity is taken from.
+    static void band(const Role role, size_t *first, size_t *last);
+
+private:
+    ProfileLibrary m_profiles;
+    std::vector<Fixture> m_fixtures;
+    std::vector<Strip> m_strips;
+    std::map<std::string, std::vector<Effect>> m_effects; // By group
+};
+
+/**
+ * A Patch flattened into one list of channel writes over all universes.
+ * Applying it is a single loop copying bytes of the fixtures' levels, without
+ * looking at profiles at all.
+ *
+ * On the way each level goes through its profile's response curve, a table
+ * with linear interpolation, so gamma costs the same for any fixture. 8 bit
+ * channels can be dithered over time: an offset cycling through 8 frames
+ * adds the lost low byte back in on average, which smoothes slow fades at low
+ * levels. Channels with a fine byte are exact and never dithered.
+ */
+class ChannelPlan
+{
+public:
+    ChannelPlan(const Patch &patch, const bool dither = false);
+
+    /// Patched universes, ascending. Their channels are laid out in this order.
+    const std::vector<uint16_t> &universes() const { return m_universes; }
+    size_t writeCount() const { return m_writes.size(); }
+
+    /**
+     * @param levels level::COUNT values per patched fixture, as EffectEngine::run()
+     * @param channels UNIVERSE_SIZE channels for each of universes()
+     * @param frame Counts up per frame, for dithering
+     */
+    void apply(const uint16_t levels[], uint8_t channels[], const uint32_t frame = 0) const;
+
+private:
+    struct Write
+    {
+        uint32_t channel = 0; // Over all universes
+        uint32_t level = 0; // Index into levels
+        uint16_t mask = 0xffff; // Of the level, 0 for fixed values
+        uint32_t curve = 0; // Offset into m_curves
+        uint8_t shift = 8; // 8 for the high byte, 0 for the low one
+        uint8_t dither = 0; // Mask for the dither offset, 0 for none
+    };
+
+    std::vector<uint16_t> m_universes;
+    std::vector<Write> m_writes; // Sorted by channel
+    // Response curves back to back, CURVE_SIZE each, and flat 2 point ones for
+    // fixed values such as pan and tilt
+    std::vector<uint32_t> m_curves;
+};
+
+}
+
+#endif
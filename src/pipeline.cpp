@@ -0,0 +1,487 @@
+#include "pipeline.h"
+
+#include "analysiscache.h"
+#include "asyncsink.h"
+#include "eventloop.h"
+#include "olaoutput.h"
+#include "samplebuffer.h"
+
+#include <SDL_log.h>
+
+#include <algorithm> // max
+#include <cmath>
+#include <thread>
+
+namespace groggle
+{
+
+static const std::chrono::milliseconds IDLE_POLL(500); // Checks for the end of input
+
+static void logStage(const char *name, const StageStats &stats)
+{
+    SDL_Log("Pipeline %s: %lu frames, %lu dropped, mean %.3f ms, max %.3f ms",
+            name,
+            static_cast<unsigned long>(stats.frames),
+            static_cast<unsigned long>(stats.dropped),
+            stats.meanTime / 1e6,
+            stats.maxTime / 1e6);
+}
+
+static void logTimer(const char *name, const Timer::Stats &stats)
+{
+    if (stats.ticks == 0) {
+        return;
+    }
+    SDL_Log("%s timer: %lu ticks, %lu skipped, lateness mean %.3f ms max %.3f ms jitter %.3f ms",
+            name,
+            static_cast<unsigned long>(stats.ticks),
+            static_cast<unsigned long>(stats.skipped),
+            stats.meanLateness / 1e6,
+            stats.maxLateness / 1e6,
+            stats.jitter / 1e6);
+}
+
+void StageStats::record(const long long time)
+{
+    frames++;
+    maxTime = std::max(maxTime, time);
+    meanTime += (time - meanTime) / frames;
+}
+
+LightPipeline::LightPipeline(const audio::Format &format,
+                             std::shared_ptr<audio::SampleBuffer> buffer,
+                             std::shared_ptr<audio::SpectrumSeries> series,
+                             std::shared_ptr<OlaOutput> olaOutput,
+                             const PipelineConfig &config)
+    : m_format(format)
+    , m_buffer(buffer)
+    , m_series(series)
+    , m_olaOutput(olaOutput)
+    , m_config(config)
+    , m_idleFrames(format.duration <= 0 && !series ? config.idleAfter * format.rate : 0)
+    , m_governor(QualityGovernor::ladder(config.analysisRate, config.outputRate))
+    // No durations, the input ends by closing the buffer. format.duration is
+    // signal time, which a generator may play faster or slower.
+    , m_analysisTimer(0, config.analysisRate)
+    , m_window(config.frameSize * format.channels)
+    , m_renderTimer(0, config.outputRate)
+{
+    m_olaOutput->setUpdateRate(config.outputRate);
+}
+
+LightPipeline::~LightPipeline()
+{
+    detach();
+}
+
+void LightPipeline::run()
+{
+    rt::applyToCurrentThread("render", m_config.renderPolicy);
+
+    m_start = std::chrono::steady_clock::now();
+    m_running = true;
+
+    std::thread analysisThread;
+    if (!m_series) {
+        analysisThread = std::thread(&LightPipeline::analysisStage, this);
+    }
+
+    m_renderTimer.setCallback([this](const long long elapsed) { render(elapsed); });
+    while (true) {
+        m_renderTimer.run();
+        if (!m_idle) {
+            break;
+        }
+
+        const auto idleStart = std::chrono::steady_clock::now();
+        sleepUntilSound();
+        m_idle = false;
+        m_idleTime += since(idleStart) / 1e9;
+        if (m_buffer->isClosed()) {
+            break;
+        }
+        SDL_Log("Pipeline: sound again after %.1f s, resuming", since(idleStart) / 1e9);
+    }
+
+    // Render is done, wind down the others
+    m_running = false;
+    if (analysisThread.joinable()) {
+        m_analysisTimer.stop();
+        m_buffer->close(); // Releases the audio trigger
+        analysisThread.join();
+    }
+
+    logStats();
+}
+
+void LightPipeline::attach(EventLoop &loop)
+{
+    m_start = std::chrono::steady_clock::now();
+    m_running = true;
+    m_eventLoop = &loop;
+    m_frameTimer = loop.addTimer(m_governor.current().outputRate, [this](const uint64_t expirations) {
+        tick(expirations);
+    });
+}
+
+void LightPipeline::detach()
+{
+    if (!m_eventLoop) {
+        return;
+    }
+
+    m_running = false;
+    if (m_frameTimer >= 0) {
+        m_eventLoop->removeTimer(m_frameTimer);
+        m_frameTimer = -1;
+    }
+    m_eventLoop = nullptr;
+    logStats();
+}
+
+void LightPipeline::logStats()
+{
+    // Timers only count skipped pulses, logging them would slow the real time loop
+    logTimer("Light", m_renderTimer.stats());
+    if (!m_series) {
+        logTimer("Analysis", m_analysisTimer.stats());
+        logStage("analysis", m_analysisStats);
+    }
+    logStage("render", m_renderStats);
+    if (m_config.sender) {
+        const AsyncSink::Stats stats = m_config.sender->stats();
+        SDL_Log("Pipeline output: %lu frames, %lu dropped, %lu failed, latency mean %.3f ms, max %.3f ms",
+                static_cast<unsigned long>(stats.frames),
+                static_cast<unsigned long>(stats.dropped),
+                static_cast<unsigned long>(stats.failed),
+                stats.meanLatency / 1e6,
+                stats.maxLatency / 1e6);
+    } else {
+        logStage("output", m_outputStats);
+    }
+    uint64_t sent = 0;
+    uint64_t unchanged = 0;
+    m_olaOutput->changeStats(&sent, &unchanged);
+    SDL_Log("Pipeline universes: %lu sent, %lu unchanged and skipped",
+            static_cast<unsigned long>(sent),
+            static_cast<unsigned long>(unchanged));
+    SDL_Log("Pipeline quality level at exit: %i", m_governor.level());
+    if (m_idleFrames > 0) {
+        SDL_Log("Pipeline idle: %lu times, %.1f s",
+                static_cast<unsigned long>(m_idlePeriods),
+                m_idleTime);
+    }
+}
+
+uint64_t LightPipeline::showTime() const
+{
+    return since(m_start);
+}
+
+long long LightPipeline::since(const std::chrono::steady_clock::time_point &start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Analysis
+// ========
+
+void LightPipeline::analysisStage()
+{
+    rt::applyToCurrentThread("analysis", m_config.analysisPolicy);
+
+    if (m_config.audioTrigger) {
+        audioTriggeredAnalysis();
+        return;
+    }
+
+    m_analysisTimer.setCallback([this](const long long) {
+        if (!m_running) {
+            m_analysisTimer.stop(); // Render ended before this timer started
+            return;
+        }
+
+        if (asleep()) {
+            m_analysisIdled = true;
+            m_analysisTimer.pause();
+            return;
+        }
+        analyze();
+    });
+
+    while (true) {
+        m_analysisIdled = false;
+        m_analysisTimer.run();
+        if (!m_analysisIdled) {
+            break;
+        }
+
+        sleepUntilSound();
+        if (!m_running || m_buffer->isClosed()) {
+            break;
+        }
+    }
+}
+
+void LightPipeline::analyze()
+{
+    if (!m_olaOutput->isEnabled()) {
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // Follow the governor. Planning only happens on level changes. The level
+    // can change meanwhile, so it is read once for both.
+    const int level = m_governor.level();
+    const QualityGovernor::Level &quality = m_governor.levels()[level];
+    if (level != m_analysisLevel) {
+        m_analysisLevel = level;
+        m_analyzer.reset(new audio::Analyzer(m_config.frameSize / quality.decimation));
+        m_decimated.resize(m_analyzer->frameSize());
+        m_analysisTimer.setFrequency(quality.analysisRate);
+    }
+
+    AnalysisFrame frame;
+    m_buffer->latest(m_window.data(), m_config.frameSize);
+    if (quality.decimation == 1) {
+        frame.spectrum = m_analyzer->transform(m_window.data(), m_format.channels);
+    } else {
+        // Same window length at a lower sample rate keeps the low bins, which
+        // are the ones the lights use, at their frequencies
+        const int step = quality.decimation;
+        for (size_t i = 0; i < m_decimated.size(); i++) {
+            int sum = 0;
+            for (int j = 0; j < step; j++) {
+                sum += m_window[(i * step + j) * m_format.channels];
+            }
+            m_decimated[i] = sum / step;
+        }
+        frame.spectrum = m_analyzer->transform(m_decimated.data(), 1);
+    }
+    frame.timestamp = showTime();
+
+    // Render stalled, the older frame is dropped for this one
+    if (!m_spectra.put(std::move(frame))) {
+        m_analysisStats.dropped++;
+    }
+
+    const long long time = since(start);
+    const float load = time * quality.analysisRate / 1e9f;
+    m_analysisLoad = load;
+    if (load > 1) {
+        m_misses++;
+    }
+    m_analysisStats.record(time);
+}
+
+void LightPipeline::audioTriggeredAnalysis()
+{
+    // Every time another hop of audio arrived in the buffer, so the lights
+    // lag the audio by at most one hop plus the FFT
+    const auto hopSize = [this]() {
+        return std::max<uint64_t>(m_format.rate / m_governor.current().analysisRate, 1);
+    };
+
+    uint64_t next = m_buffer->written() + hopSize();
+    while (m_running && !m_buffer->isClosed()) {
+        if (asleep()) {
+            sleepUntilSound();
+            next = m_buffer->written() + hopSize();
+            continue;
+        }
+
+        if (!m_buffer->waitFor(next, std::chrono::milliseconds(500))) {
+            continue; // Paused input, or closed
+        }
+
+        // Only the newest window matters, don't queue up hops we missed
+        const uint64_t hop = hopSize();
+        const uint64_t written = m_buffer->written();
+        if (written >= next + hop) {
+            const uint64_t missed = (written - next) / hop;
+            m_analysisStats.dropped += missed;
+            m_misses += missed;
+            next += missed * hop;
+        }
+        next += hop;
+
+        analyze();
+    }
+}
+
+// Render
+// ======
+
+void LightPipeline::render(const long long elapsed)
+{
+    if (m_buffer->isClosed()) {
+        m_renderTimer.stop(); // Input ended
+        return;
+    }
+
+    if (isSilent()) {
+        enterIdle();
+        return;
+    }
+
+    if (!m_olaOutput->isEnabled()) {
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    if (!renderFrame(elapsed, &m_dmx)) {
+        return;
+    }
+
+    // Only queues it for the sender
+    m_olaOutput->send(m_dmx);
+
+    const long long time = since(start);
+    m_renderStats.record(time);
+    govern(time * m_governor.current().outputRate / 1e9f);
+}
+
+void LightPipeline::tick(const uint64_t expirations)
+{
+    // Expirations the loop was too busy for are this mode's skipped pulses
+    m_misses += expirations - 1;
+
+    if (m_idle) {
+        if (asleep()) {
+            return; // PulseAudio wakes the loop per fragment, checking is cheap
+        }
+        m_idle = false;
+        SDL_Log("Pipeline: sound again, resuming");
+    }
+
+    if (isSilent()) {
+        enterIdle();
+        return;
+    }
+
+    if (!m_olaOutput->isEnabled()) {
+        return;
+    }
+
+    // Analysis, render and output in one go, at their own rates
+    const long long elapsed = showTime();
+    if (!m_series && elapsed >= m_nextAnalysis) {
+        analyze();
+        const long long interval = round(1e9 / m_governor.current().analysisRate);
+        m_nextAnalysis = (elapsed / interval + 1) * interval;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    if (!renderFrame(elapsed, &m_dmx)) {
+        return;
+    }
+    m_renderStats.record(since(start));
+
+    const auto sendStart = std::chrono::steady_clock::now();
+    m_olaOutput->send(m_dmx);
+    m_outputStats.record(since(sendStart));
+
+    govern(since(start) * m_governor.current().outputRate / 1e9f);
+}
+
+bool LightPipeline::isSilent() const
+{
+    return m_idleFrames > 0 && m_buffer->written() - m_buffer->lastSound() > m_idleFrames;
+}
+
+bool LightPipeline::renderFrame(const long long elapsed, DmxFrame *dmx)
+{
+    audio::Spectrum spectrum;
+    if (m_series) {
+        spectrum = m_series->interpolated(elapsed);
+    } else {
+        AnalysisFrame frame;
+        if (m_spectra.take(&frame)) {
+            m_interpolator.push(frame.timestamp, frame.spectrum);
+        }
+
+        if (!m_interpolator.at(showTime(), &spectrum)) {
+            return false; // Nothing analyzed yet
+        }
+    }
+
+    m_olaOutput->render(spectrum, dmx);
+    return true;
+}
+
+void LightPipeline::govern(const float renderLoad)
+{
+    if (!m_config.adaptive) {
+        return;
+    }
+
+    // Skipped render pulses count as well as the other stages' misses
+    const uint64_t total = misses() + m_renderTimer.stats().skipped;
+    const bool missed = total != m_seenMisses;
+    m_seenMisses = total;
+
+    if (!m_governor.report(missed, std::max<float>(renderLoad, m_analysisLoad))) {
+        return;
+    }
+
+    const int level = m_governor.level();
+    const QualityGovernor::Level &quality = m_governor.levels()[level];
+    if (m_eventLoop) {
+        m_eventLoop->setTimerFrequency(m_frameTimer, quality.outputRate);
+    } else {
+        m_renderTimer.setFrequency(quality.outputRate);
+    }
+    m_olaOutput->setUpdateRate(quality.outputRate);
+    SDL_Log("Quality level %i of %i: FFT size %lu, analysis %.1f Hz, output %.1f Hz",
+            level,
+            m_governor.levelCount() - 1,
+            static_cast<unsigned long>(m_config.frameSize / quality.decimation),
+            quality.analysisRate,
+            quality.outputRate);
+    if (m_config.qualityChanged) {
+        m_config.qualityChanged(level);
+    }
+}
+
+uint64_t LightPipeline::misses() const
+{
+    // The sender only drops frames when the sink cannot keep up with the
+    // render rate
+    return m_misses + (m_config.sender ? m_config.sender->dropped() : 0);
+}
+
+// Idling
+// ======
+
+void LightPipeline::enterIdle()
+{
+    m_idleSince = m_buffer->lastSound();
+    m_idle = true;
+    m_idlePeriods++;
+
+    // One final frame, then nothing until there is sound again
+    m_olaOutput->send(m_olaOutput->blackoutFrame());
+    if (m_eventLoop) {
+        return;
+    }
+
+    m_renderTimer.pause();
+    SDL_Log("Pipeline: %.1f s of silence, idling", m_config.idleAfter);
+}
+
+bool LightPipeline::asleep() const
+{
+    return m_idle && m_buffer->lastSound() <= m_idleSince;
+}
+
+void LightPipeline::sleepUntilSound()
+{
+    // The buffer wakes us with the first push that holds sound, i.e. within
+    // one hop
+    while (m_running && asleep() && !m_buffer->isClosed()) {
+        m_buffer->waitForSound(m_idleSince, IDLE_POLL);
+    }
+}
+
+}
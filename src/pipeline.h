@@ -0,0 +1,185 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "analyzer.h"
+#include "audiosource.h"
+#include "dmxsink.h"
+#include "governor.h"
+#include "mailbox.h"
+#include "realtime.h"
+#include "spectrum.h"
+#include "timer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace groggle
+{
+
+namespace audio
+{
+class SpectrumSeries;
+}
+
+class AsyncSink;
+class EventLoop;
+class OlaOutput;
+
+struct PipelineConfig
+{
+    size_t frameSize = 1024; // Analysis window in frames
+    float analysisRate = 30; // Hz
+    float outputRate = 44; // Hz
+    bool audioTrigger = false; // Analyze on audio arrival instead of a timer
+    bool adaptive = true; // Lower the quality when deadlines are missed
+    float idleAfter = 0; // s of silence before idling, 0 never. Live input only.
+    std::function<void(const int level)> qualityChanged; // Called by the render thread, must not block
+    rt::ThreadPolicy analysisPolicy;
+    rt::ThreadPolicy renderPolicy;
+    std::shared_ptr<AsyncSink> sender; // The output's send thread, if any
+};
+
+/**
+ * Time spent per frame in one stage.
+ */
+struct StageStats
+{
+    uint64_t frames = 0;
+    uint64_t dropped = 0;
+    long long maxTime = 0; // ns
+    double meanTime = 0; // ns
+
+    void record(const long long time);
+};
+
+/**
+ * Turns audio into light in three stages with a thread each, so a slow send
+ * cannot delay the next analysis:
+ *
+ * - analysis: FFT of the newest window, on a timer or on audio arrival
+ * - render: at the output rate, interpolates the spectra and computes DMX
+ * - output: the sender (an AsyncSink) passes the newest frame on
+ *
+ * Analysis and render are connected by a lock-free mailbox, a new analysis
+ * replaces one the render has not taken yet instead of blocking. The sender
+ * always skips to the newest frame too. A pre-analyzed series replaces the
+ * analysis stage.
+ *
+ * Missed deadlines in any stage are reported to a QualityGovernor, whose
+ * level the analysis and render stages follow.
+ *
+ * attach() runs the same stages on an event loop instead, without threads.
+ *
+ * After a period of silence on live input the pipeline idles: it sends one
+ * last blackout frame, and analysis and render sleep until the buffer
+ * receives sound again.
+ */
+class LightPipeline
+{
+public:
+    LightPipeline(const audio::Format &format,
+                  std::shared_ptr<audio::SampleBuffer> buffer,
+                  std::shared_ptr<audio::SpectrumSeries> series,
+                  std::shared_ptr<OlaOutput> olaOutput,
+                  const PipelineConfig &config);
+    ~LightPipeline();
+
+    /**
+     * Runs the render stage on the calling thread and the others on their
+     * own. Blocks until the input ends, i.e. its duration passed or the buffer
+     * was closed.
+     */
+    void run();
+
+    /**
+     * Alternative to run() for a single thread: analyzes, renders and sends
+     * from a frame timer in the event loop. Runs until detach().
+     */
+    void attach(EventLoop &loop);
+    void detach();
+
+    /// 0 is full quality. Thread safe.
+    int qualityLevel() const { return m_governor.level(); }
+
+private:
+    LightPipeline(const LightPipeline&) = delete;
+    LightPipeline &operator=(const LightPipeline&) = delete;
+
+    struct AnalysisFrame
+    {
+        uint64_t timestamp = 0; // ns, showTime()
+        audio::Spectrum spectrum;
+    };
+
+    void analysisStage();
+    void analyze();
+    void audioTriggeredAnalysis();
+    void render(const long long elapsed);
+    void tick(const uint64_t expirations);
+    bool renderFrame(const long long elapsed, DmxFrame *dmx);
+    void govern(const float renderLoad);
+    bool isSilent() const;
+    void enterIdle();
+    bool asleep() const;
+    void sleepUntilSound();
+    /// Misses of the analysis stage and the sender
+    uint64_t misses() const;
+
+    void logStats();
+
+    /// ns since run(), the clock shared by all stages
+    uint64_t showTime() const;
+    static long long since(const std::chrono::steady_clock::time_point &start);
+
+    const audio::Format m_format;
+    std::shared_ptr<audio::SampleBuffer> m_buffer;
+    std::shared_ptr<audio::SpectrumSeries> m_series;
+    std::shared_ptr<OlaOutput> m_olaOutput;
+    const PipelineConfig m_config;
+
+    std::chrono::steady_clock::time_point m_start;
+    std::atomic<bool> m_running { false };
+
+    const uint64_t m_idleFrames; // Of silence before idling, 0 never
+    std::atomic<bool> m_idle { false };
+    std::atomic<uint64_t> m_idleSince { 0 }; // lastSound() when idling began
+    uint64_t m_idlePeriods = 0;
+    double m_idleTime = 0; // s
+
+    QualityGovernor m_governor;
+    std::atomic<uint64_t> m_misses { 0 }; // Of the analysis and output stages
+    std::atomic<float> m_analysisLoad { 0 }; // Last analysis time / interval
+
+    // Analysis stage
+    Timer m_analysisTimer;
+    bool m_analysisIdled = false; // Timer stopped for idling
+    int m_analysisLevel = -1; // Quality level m_analyzer was made for
+    std::unique_ptr<audio::Analyzer> m_analyzer;
+    std::vector<int16_t> m_window;
+    std::vector<int16_t> m_decimated; // Mono, every n-th frame of m_window
+    StageStats m_analysisStats;
+    Mailbox<AnalysisFrame> m_spectra;
+
+    // Render stage
+    Timer m_renderTimer;
+    uint64_t m_seenMisses = 0;
+    audio::SpectrumInterpolator m_interpolator;
+    DmxFrame m_dmx; // Rendered into every frame, also in event loop mode
+    StageStats m_renderStats;
+
+    // Output stage, only measured here when sending synchronously
+    StageStats m_outputStats;
+
+    // Event loop mode, all of the above on one thread
+    EventLoop *m_eventLoop = nullptr;
+    int m_frameTimer = -1;
+    long long m_nextAnalysis = 0; // ns
+};
+
+}
+
+#endif
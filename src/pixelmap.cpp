@@ -0,0 +1,152 @@
+#include "pixelmap.h"
+
+#include "color.h"
+
+#include <algorithm> // fill, lower_bound, min
+#include <cmath>
+
+namespace groggle
+{
+
+// Bars go from 43 Hz to 11 kHz at 44.1 kHz and 1024 frames, logarithmically
+static const size_t MAX_BIN = 255;
+
+PixelMap::PixelMap(const Patch &patch, const ChannelPlan &plan)
+{
+    for (const Patch::Strip &strip : patch.strips()) {
+        m_pixels += strip.pixels;
+    }
+
+    const size_t vectors = (m_pixels + LANES - 1) / LANES;
+    m_gain.assign(vectors, Lanes {});
+    m_rainbow.assign(vectors, Lanes {});
+    m_baseR.assign(vectors, Lanes {});
+    m_baseG.assign(vectors, Lanes {});
+    m_baseB.assign(vectors, Lanes {});
+    m_input.assign(vectors, Lanes {});
+    m_value.assign(vectors, Lanes {});
+    m_bytes.assign(3 * vectors * LANES, 0);
+    m_bin.assign(m_pixels, 0);
+    m_role.assign(m_pixels, -1);
+    m_position.assign(m_pixels, 0);
+    m_bins.assign(MAX_BIN + 1, 0);
+
+    // Lanes may alias their floats
+    float *gain = reinterpret_cast<float*>(m_gain.data());
+    float *rainbow = reinterpret_cast<float*>(m_rainbow.data());
+    float *baseR = reinterpret_cast<float*>(m_baseR.data());
+    float *baseG = reinterpret_cast<float*>(m_baseG.data());
+    float *baseB = reinterpret_cast<float*>(m_baseB.data());
+
+    const std::vector<uint16_t> &universes = plan.universes();
+    size_t pixel = 0;
+    for (const Patch::Strip &strip : patch.strips()) {
+        // Split into runs per universe, pixels never straddle two
+        uint32_t universe = strip.universe;
+        size_t channel = strip.address - 1;
+        size_t left = strip.pixels;
+        while (left > 0) {
+            Segment segment;
+            segment.first = pixel + strip.pixels - left;
+            segment.count = std::min<size_t>(left, (UNIVERSE_SIZE - channel) / 3);
+            const size_t slot = std::lower_bound(universes.begin(), universes.end(), universe) - universes.begin();
+            segment.channel = slot * UNIVERSE_SIZE + channel;
+            std::copy(strip.order, strip.order + 3, segment.order);
+            m_segments.push_back(segment);
+
+            left -= segment.count;
+            universe++;
+            channel = 0;
+        }
+
+        for (size_t i = 0; i < strip.pixels; i++, pixel++) {
+            const float position = (i + 0.5f) / strip.pixels;
+            m_position[pixel] = position;
+            gain[pixel] = strip.gain;
+
+            if (strip.mode == Patch::Strip::Mode::VU) {
+                m_role[pixel] = static_cast<int8_t>(strip.role);
+            } else {
+                m_bin[pixel] = round(std::pow(static_cast<float>(MAX_BIN), position));
+            }
+
+            if (strip.rainbow) {
+                rainbow[pixel] = 1;
+                baseR[pixel] = position * 360.0f; // Hue for now
+            }
+        }
+    }
+
+    // Hue along the strip, converted all at once
+    const std::vector<float> full(m_pixels, 1.0f);
+    hsvToRgb(baseR, rainbow, full.data(), baseR, baseG, baseB, m_pixels);
+}
+
+void PixelMap::render(const audio::Spectrum &spectrum,
+                      const float rgb[3],
+                      const float intensities[ROLE_COUNT],
+                      const float decay,
+                      uint8_t channels[])
+{
+    if (m_pixels == 0) {
+        return;
+    }
+
+    // 1. Gather, the only scalar part. Decimated spectra have fewer bins.
+    const size_t bins = std::min(spectrum.size(), m_bins.size());
+    std::copy(spectrum.begin(), spectrum.begin() + bins, m_bins.begin());
+    std::fill(m_bins.begin() + bins, m_bins.end(), 0.0f);
+
+    float *input = reinterpret_cast<float*>(m_input.data());
+    for (size_t i = 0; i < m_pixels; i++) {
+        const int role = m_role[i];
+        input[i] = role < 0 ? m_bins[m_bin[i]] : (intensities[role] >= m_position[i] ? 1.0f : 0.0f);
+    }
+
+    // 2. and 3., LANES pixels at a time
+    typedef int IntLanes __attribute__((vector_size(16)));
+    const Lanes zero = {};
+    const Lanes one = zero + 1.0f;
+    const Lanes plainR = zero + rgb[0];
+    const Lanes plainG = zero + rgb[1];
+    const Lanes plainB = zero + rgb[2];
+    const size_t vectors = m_value.size();
+    uint8_t *red = m_bytes.data();
+    uint8_t *green = red + vectors * LANES;
+    uint8_t *blue = green + vectors * LANES;
+    for (size_t v = 0; v < vectors; v++) {
+        const Lanes in = m_input[v] * m_gain[v];
+        const Lanes held = m_value[v] * decay;
+        Lanes value = in > held ? in : held;
+        value = value > one ? one : value < zero ? zero : value;
+        m_value[v] = value;
+
+        const Lanes mix = m_rainbow[v];
+        const Lanes r = value * (mix * m_baseR[v] + (one - mix) * plainR);
+        const Lanes g = value * (mix * m_baseG[v] + (one - mix) * plainG);
+        const Lanes b = value * (mix * m_baseB[v] + (one - mix) * plainB);
+
+        // 4. To bytes, rounded
+        const IntLanes r8 = __builtin_convertvector(r * 255.0f + 0.5f, IntLanes);
+        const IntLanes g8 = __builtin_convertvector(g * 255.0f + 0.5f, IntLanes);
+        const IntLanes b8 = __builtin_convertvector(b * 255.0f + 0.5f, IntLanes);
+        for (size_t l = 0; l < LANES; l++) {
+            red[v * LANES + l] = r8[l];
+            green[v * LANES + l] = g8[l];
+            blue[v * LANES + l] = b8[l];
+        }
+    }
+
+    // Interleave into the universes, in each strip's color order
+    for (const Segment &segment : m_segments) {
+        uint8_t *out = &channels[segment.channel];
+        for (size_t i = 0; i < segment.count; i++) {
+            const size_t pixel = segment.first + i;
+            out[3 * i + segment.order[0]] = red[pixel];
+            out[3 * i + segment.order[1]] = green[pixel];
+            out[3 * i + segment.order[2]] = blue[pixel];
+        }
+    }
+}
+
+}
@@ -0,0 +1,85 @@
+#ifndef PIXELMAP_H
+#define PIXELMAP_H
+
+#include "patch.h"
+#include "spectrum.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace groggle
+{
+
+/**
+ * Renders all patched LED strips at once. Pixels are kept as a structure of
+ * arrays (one array per component, padded to whole vectors) so the color math
+ * runs on 4 pixels per instruction, SSE and NEON alike.
+ *
+ * Per frame:
+ *   1. gather each pixel's input: its spectrum bin (bars) or whether the
+ *      role's level reaches its position (VU meter)
+ *   2. peak hold with decay, times the pixel's gain
+ *   3. times the pixel's base color
+ *   4. to bytes, written straight into the frame's universes
+ */
+class PixelMap
+{
+public:
+    /// Strips with their universes in the layout of the plan's universes.
+    PixelMap(const Patch &patch, const ChannelPlan &plan);
+
+    size_t pixelCount() const { return m_pixels; }
+
+    /**
+     * @param rgb Color of strips without a rainbow, 0-1
+     * @param intensities The roles' levels, 0-1, for VU meters
+     * @param decay Factor per frame for the peak hold
+     * @param channels The frame's channels, as for ChannelPlan::apply()
+     */
+    void render(const audio::Spectrum &spectrum,
+                const float rgb[3],
+                const float intensities[ROLE_COUNT],
+                const float decay,
+                uint8_t channels[]);
+
+private:
+    PixelMap(const PixelMap&) = delete;
+    PixelMap &operator=(const PixelMap&) = delete;
+
+    /// A run of pixels that are contiguous in one universe
+    struct Segment
+    {
+        size_t first = 0; // Pixel
+        size_t count = 0;
+        size_t channel = 0; // Of the first pixel, over all universes
+        uint8_t order[3] = { 0, 1, 2 }; // Offsets of red, green and blue
+    };
+
+    typedef float Lanes __attribute__((vector_size(16)));
+    static const size_t LANES = 4;
+
+    size_t m_pixels = 0;
+
+    // Per pixel, in vectors of LANES pixels, the last one padded
+    std::vector<Lanes> m_gain;
+    std::vector<Lanes> m_rainbow; // 1 to use the base color, 0 for the given one
+    std::vector<Lanes> m_baseR;
+    std::vector<Lanes> m_baseG;
+    std::vector<Lanes> m_baseB;
+    std::vector<Lanes> m_input; // Scratch
+    std::vector<Lanes> m_value; // Peak hold
+    std::vector<uint8_t> m_bytes; // Scratch, red for all pixels, then green, then blue
+
+    // Inputs, per pixel
+    std::vector<uint16_t> m_bin; // Spectrum bars
+    std::vector<int8_t> m_role; // VU meters, -1 for spectrum bars
+    std::vector<float> m_position; // VU meters, 0-1 along the strip
+
+    std::vector<float> m_bins; // Spectrum, contiguous, scratch
+    std::vector<Segment> m_segments;
+};
+
+}
+
+#endif
@@ -0,0 +1,191 @@
+#include "realtime.h"
+
+#include <SDL_log.h>
+
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace groggle
+{
+namespace rt
+{
+
+static const size_t STACK_PREFAULT_SIZE = 256 * 1024;
+
+static const char *schedulerName(const ThreadPolicy::Scheduler scheduler)
+{
+    switch (scheduler) {
+    case ThreadPolicy::Scheduler::INHERIT:
+        return "inherited";
+    case ThreadPolicy::Scheduler::OTHER:
+        return "SCHED_OTHER";
+    case ThreadPolicy::Scheduler::FIFO:
+        return "SCHED_FIFO";
+    case ThreadPolicy::Scheduler::RR:
+        return "SCHED_RR";
+    }
+    return "?";
+}
+
+static bool parseInt(const std::string &text, const int min, const int max, int *value)
+{
+    if (text.empty()) {
+        return false;
+    }
+
+    char *end = nullptr;
+    const long parsed = strtol(text.c_str(), &end, 10);
+    if (*end != '\0' || parsed < min || parsed > max) {
+        return false;
+    }
+
+    *value = parsed;
+    return true;
+}
+
+bool ThreadPolicy::parse(const std::string &spec, ThreadPolicy *policy)
+{
+    ThreadPolicy result;
+
+    std::string scheduling = spec;
+    const size_t at = spec.find('@');
+    if (at != std::string::npos) {
+        scheduling = spec.substr(0, at);
+        if (!parseInt(spec.substr(at + 1), 0, CPU_SETSIZE - 1, &result.cpu)) {
+            SDL_Log("Invalid CPU in thread policy \"%s\"", spec.c_str());
+            return false;
+        }
+    }
+
+    std::string name = scheduling;
+    std::string priority;
+    const size_t colon = scheduling.find(':');
+    if (colon != std::string::npos) {
+        name = scheduling.substr(0, colon);
+        priority = scheduling.substr(colon + 1);
+    }
+
+    if (name == "fifo") {
+        result.scheduler = Scheduler::FIFO;
+    } else if (name == "rr") {
+        result.scheduler = Scheduler::RR;
+    } else if (name == "other") {
+        result.scheduler = Scheduler::OTHER;
+    } else if (!name.empty()) {
+        SDL_Log("Unknown scheduler \"%s\", expected fifo, rr or other", name.c_str());
+        return false;
+    }
+
+    const bool realtime = result.scheduler == Scheduler::FIFO || result.scheduler == Scheduler::RR;
+    if (realtime) {
+        // Below most kernel threads, above everything else by default
+        result.priority = 50;
+        if (!priority.empty() && !parseInt(priority, 1, 99, &result.priority)) {
+            SDL_Log("Invalid priority in thread policy \"%s\", expected 1-99", spec.c_str());
+            return false;
+        }
+    } else if (!priority.empty()) {
+        SDL_Log("Only fifo and rr take a priority: \"%s\"", spec.c_str());
+        return false;
+    }
+
+    *policy = result;
+    return true;
+}
+
+bool applyToCurrentThread(const char *name, const ThreadPolicy &policy)
+{
+    if (policy.isDefault()) {
+        return true;
+    }
+
+    bool granted = true;
+    const pthread_t thread = pthread_self();
+
+    if (policy.cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(policy.cpu, &cpus);
+        const int result = pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+        if (result != 0) {
+            SDL_Log("Realtime: %s thread not pinned to CPU %i: %s", name, policy.cpu, strerror(result));
+            granted = false;
+        }
+    }
+
+    if (policy.scheduler != ThreadPolicy::Scheduler::INHERIT) {
+        int scheduler = SCHED_OTHER;
+        if (policy.scheduler == ThreadPolicy::Scheduler::FIFO) {
+            scheduler = SCHED_FIFO;
+        } else if (policy.scheduler == ThreadPolicy::Scheduler::RR) {
+            scheduler = SCHED_RR;
+        }
+
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = policy.priority;
+        const int result = pthread_setschedparam(thread, scheduler, &param);
+        if (result != 0) {
+            // EPERM without CAP_SYS_NICE or an rtprio rlimit
+            SDL_Log("Realtime: %s thread not granted %s priority %i: %s",
+                    name, schedulerName(policy.scheduler), policy.priority, strerror(result));
+            granted = false;
+        }
+    }
+
+    // Report what the thread actually ended up with
+    int scheduler = 0;
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    pthread_getschedparam(thread, &scheduler, &param);
+    const char *schedulerText = scheduler == SCHED_FIFO ? "SCHED_FIFO"
+                              : scheduler == SCHED_RR ? "SCHED_RR"
+                              : "SCHED_OTHER";
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    std::string cpuList;
+    if (pthread_getaffinity_np(thread, sizeof(cpus), &cpus) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &cpus)) {
+                cpuList += (cpuList.empty() ? "" : ",") + std::to_string(cpu);
+            }
+        }
+    }
+
+    SDL_Log("Realtime: %s thread runs %s priority %i on CPUs %s",
+            name, schedulerText, param.sched_priority, cpuList.c_str());
+
+    prefaultStack(STACK_PREFAULT_SIZE);
+    return granted;
+}
+
+bool lockMemory()
+{
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        SDL_Log("Realtime: mlockall failed: %s", strerror(errno));
+        return false;
+    }
+
+    prefaultStack(STACK_PREFAULT_SIZE);
+    SDL_Log("Realtime: memory locked");
+    return true;
+}
+
+void prefaultStack(const size_t size)
+{
+    // volatile, or the compiler drops the writes
+    volatile char *stack = static_cast<volatile char*>(alloca(size));
+    for (size_t i = 0; i < size; i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+}
+}
@@ -0,0 +1,52 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <cstddef>
+#include <string>
+
+namespace groggle
+{
+namespace rt
+{
+
+/**
+ * How a thread should be scheduled. The defaults leave it alone.
+ */
+struct ThreadPolicy
+{
+    enum class Scheduler { INHERIT, OTHER, FIFO, RR };
+
+    Scheduler scheduler = Scheduler::INHERIT;
+    int priority = 0; // 1-99 for FIFO and RR
+    int cpu = -1; // Pinned to this core if >= 0
+
+    bool isDefault() const { return scheduler == Scheduler::INHERIT && cpu < 0; }
+
+    /**
+     * Parses "<fifo|rr|other>[:priority][@cpu]" or just "@cpu", e.g.
+     * "fifo:80@2". Logs what is wrong with invalid specs.
+     */
+    static bool parse(const std::string &spec, ThreadPolicy *policy);
+};
+
+/**
+ * Applies the policy to the calling thread and logs what was granted. Fails
+ * softly: the thread keeps running with whatever it got.
+ * @param name Used in the log only
+ * @return Whether everything was granted
+ */
+bool applyToCurrentThread(const char *name, const ThreadPolicy &policy);
+
+/**
+ * Locks all current and future pages of the process into RAM and pre-faults
+ * the calling thread's stack, so page faults cannot stall the light loop.
+ */
+bool lockMemory();
+
+/// Touches size bytes of the calling thread's stack.
+void prefaultStack(const size_t size);
+
+}
+}
+
+#endif
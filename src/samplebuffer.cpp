@@ -0,0 +1,147 @@
+#include "samplebuffer.h"
+
+#include <algorithm> // min
+#include <cstdlib>
+#include <cstring>
+
+namespace groggle
+{
+namespace audio
+{
+
+SampleBuffer::SampleBuffer(const size_t capacity, const int channels)
+    : m_capacity(capacity)
+    , m_channels(channels)
+    , m_samples(capacity * channels, 0)
+{}
+
+void SampleBuffer::push(const int16_t samples[], const size_t frameCount)
+{
+    // Outside the lock, most pushes are decided after a few samples
+    const int threshold = m_silenceThreshold;
+    bool sound = false;
+    for (size_t i = 0; i < frameCount * m_channels && !sound; i++) {
+        sound = std::abs(samples[i]) > threshold;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // Only the tail fits if we get more than the whole ring at once
+    size_t skipped = 0;
+    if (frameCount > m_capacity) {
+        skipped = frameCount - m_capacity;
+    }
+
+    size_t remaining = frameCount - skipped;
+    const int16_t *src = &samples[skipped * m_channels];
+    while (remaining > 0) {
+        const size_t count = std::min(remaining, m_capacity - m_head);
+        memcpy(&m_samples[m_head * m_channels], src, count * m_channels * sizeof(int16_t));
+        m_head = (m_head + count) % m_capacity;
+        src += count * m_channels;
+        remaining -= count;
+    }
+
+    m_written += frameCount;
+
+    bool wake = false;
+    if (m_written >= m_wakeAt) {
+        m_wakeAt = UINT64_MAX;
+        wake = true;
+    }
+
+    if (sound) {
+        m_lastSound = m_written;
+        wake = wake || m_wakeOnSound;
+        m_wakeOnSound = false;
+    }
+
+    if (wake) {
+        lock.unlock();
+        m_arrived.notify_all();
+    }
+}
+
+size_t SampleBuffer::latest(int16_t dst[], const size_t frameCount) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const size_t available = std::min<uint64_t>(m_written, m_capacity);
+    const size_t count = std::min(frameCount, available);
+
+    // Start 'count' frames behind the write head, possibly wrapping around
+    size_t pos = (m_head + m_capacity - count) % m_capacity;
+    size_t remaining = count;
+    while (remaining > 0) {
+        const size_t chunk = std::min(remaining, m_capacity - pos);
+        memcpy(dst, &m_samples[pos * m_channels], chunk * m_channels * sizeof(int16_t));
+        pos = (pos + chunk) % m_capacity;
+        dst += chunk * m_channels;
+        remaining -= chunk;
+    }
+
+    return count;
+}
+
+uint64_t SampleBuffer::written() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_written;
+}
+
+bool SampleBuffer::waitFor(const uint64_t target, const std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (m_written < target && !m_closed) {
+        // Other waiters may have reset it in the meantime
+        m_wakeAt = std::min(m_wakeAt, target);
+        if (m_arrived.wait_until(lock, deadline) == std::cv_status::timeout) {
+            break;
+        }
+    }
+
+    return m_written >= target;
+}
+
+void SampleBuffer::setSilenceThreshold(const int16_t threshold)
+{
+    m_silenceThreshold = threshold;
+}
+
+uint64_t SampleBuffer::lastSound() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastSound;
+}
+
+bool SampleBuffer::waitForSound(const uint64_t since, const std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (m_lastSound <= since && !m_closed) {
+        m_wakeOnSound = true;
+        if (m_arrived.wait_until(lock, deadline) == std::cv_status::timeout) {
+            break;
+        }
+    }
+
+    return m_lastSound > since;
+}
+
+void SampleBuffer::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_arrived.notify_all();
+}
+
+bool SampleBuffer::isClosed() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_closed;
+}
+
+}
+}
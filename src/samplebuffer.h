@@ -0,0 +1,90 @@
+#ifndef SAMPLEBUFFER_H
+#define SAMPLEBUFFER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace groggle
+{
+namespace audio
+{
+
+/**
+ * Fixed-size ring of interleaved s16 frames. Audio sources push whatever
+ * they receive, the analysis side copies out the most recent frames and may
+ * wait for new ones to arrive.
+ */
+class SampleBuffer
+{
+public:
+    /**
+     * @param capacity Ring size in frames (one frame = one sample per channel)
+     * @param channels Number of interleaved channels per frame
+     */
+    SampleBuffer(const size_t capacity, const int channels);
+
+    size_t capacity() const { return m_capacity; }
+    int channels() const { return m_channels; }
+
+    void push(const int16_t samples[], const size_t frameCount);
+
+    /**
+     * Copies the most recent frames into dst, oldest first.
+     * @return The number of frames copied, less than frameCount if the
+     * buffer does not hold that many yet.
+     */
+    size_t latest(int16_t dst[], const size_t frameCount) const;
+
+    /// Total number of frames pushed so far.
+    uint64_t written() const;
+
+    /**
+     * Blocks until written() reaches target, the buffer is closed or the
+     * timeout expires. Pushes only wake up the waiter once target is reached.
+     * @return Whether target was reached
+     */
+    bool waitFor(const uint64_t target, const std::chrono::milliseconds timeout);
+
+    /// Samples louder than this (absolute) count as sound, c.f. lastSound().
+    void setSilenceThreshold(const int16_t threshold);
+
+    /// written() at the end of the last push that contained sound.
+    uint64_t lastSound() const;
+
+    /**
+     * Blocks until sound arrived after the given lastSound(), the buffer is
+     * closed or the timeout expires.
+     * @return Whether there was sound
+     */
+    bool waitForSound(const uint64_t since, const std::chrono::milliseconds timeout);
+
+    /// Marks the end of the stream and wakes up all waiters.
+    void close();
+    bool isClosed() const;
+
+private:
+    mutable std::mutex m_mutex;
+    const size_t m_capacity;
+    const int m_channels;
+    std::vector<int16_t> m_samples;
+    size_t m_head = 0; // Next frame to write
+    uint64_t m_written = 0;
+
+    std::condition_variable m_arrived;
+    uint64_t m_wakeAt = UINT64_MAX; // Lowest target any waiter waits for
+    bool m_wakeOnSound = false;
+    bool m_closed = false;
+
+    std::atomic<int> m_silenceThreshold { 0 }; // Read without the lock
+    uint64_t m_lastSound = 0;
+};
+
+}
+}
+
+#endif
@@ -4,31 +4,34 @@
 #include <SDL_audio.h>
 #include <SDL_log.h>
 
-using namespace groggle;
+#include <algorithm> // min
 
-void inputCallback(void *userData, uint8_t *stream, int bufferSize)
+using namespace groggle::audio::sdl;
+
+// CaptureSource
+// =============
+
+CaptureSource::CaptureSource(const std::string &device)
+    : m_device(device)
+{}
+
+CaptureSource::~CaptureSource()
 {
-    AudioMetadata *meta = reinterpret_cast<AudioMetadata *>(userData);
-    std::lock_guard<std::mutex>(meta->mutex);
-    memcpy(meta->data, stream, bufferSize);
-    meta->dataSize = bufferSize;
-    meta->position = 0;
+    if (m_deviceID != 0) {
+        SDL_PauseAudioDevice(m_deviceID, 1);
+        SDL_CloseAudioDevice(m_deviceID);
+    }
 }
 
-void outputCallback(void *userData, uint8_t *stream, int bufferSize)
+void CaptureSource::callback(void *userData, uint8_t *stream, int bufferSize)
 {
-    AudioMetadata *meta = reinterpret_cast<AudioMetadata *>(userData);
-    std::lock_guard<std::mutex>(meta->mutex);
-    const uint32_t count = std::min(static_cast<uint32_t>(bufferSize),
-                                    meta->dataSize - meta->position);
-    memcpy(stream, &meta->data[meta->position], count);
-    //SDL_Log("Audio pos: %f", meta->position / (float)meta->dataSize);
-    meta->position += count;
+    CaptureSource *source = reinterpret_cast<CaptureSource *>(userData);
+    const int frameSize = sizeof(int16_t) * source->format().channels;
+    source->deliver(reinterpret_cast<int16_t *>(stream), bufferSize / frameSize);
 }
 
-bool audio::sdl::openInputDevice(AudioMetadataPtr meta)
+bool CaptureSource::open()
 {
-    std::lock_guard<std::mutex>(meta->mutex);
     SDL_AudioSpec have;
     SDL_AudioSpec want;
     SDL_zero(want);
@@ -36,96 +39,173 @@ bool audio::sdl::openInputDevice(AudioMetadataPtr meta)
     want.format = AUDIO_S16LSB;
     want.samples = 1024; // Buffer size in samples
     want.channels = 1;
-    want.callback = &inputCallback;
-    want.userdata = meta.get();
+    want.callback = &CaptureSource::callback;
+    want.userdata = this;
 
-    meta->audioDeviceID = SDL_OpenAudioDevice(meta->audioDevice.c_str(), true, &want, &have, 0);
-    if (meta->audioDeviceID == 0) {
+    m_deviceID = SDL_OpenAudioDevice(m_device.c_str(), true, &want, &have, 0);
+    if (m_deviceID == 0) {
+        SDL_Log("Failed to open SDL capture device: %s", SDL_GetError());
         return false;
     }
 
     SDL_Log("Want Freq: %i Format: 0x%0i Samples: %i Channels: %i", want.freq, want.format, want.samples, want.channels);
     SDL_Log("Have Freq: %i Format: 0x%0i Samples: %i Channels: %i", have.freq, have.format, have.samples, have.channels);
 
-    meta->fileSpec = have;
-    meta->duration = 0; // infinity
-    meta->data = new uint8_t[have.size]; // samples != bytes
-
-    SDL_PauseAudioDevice(meta->audioDeviceID, 0);
+    Format format;
+    format.rate = have.freq;
+    format.channels = have.channels;
+    format.latency = have.samples / static_cast<float>(have.freq);
+    format.duration = 0; // infinity
+    setFormat(format);
     return true;
 }
 
-void audio::sdl::closeInputDevice(AudioMetadataPtr meta)
+int CaptureSource::run()
 {
-    std::lock_guard<std::mutex>(meta->mutex);
-    SDL_PauseAudioDevice(meta->audioDeviceID, 1);
-    SDL_CloseAudioDevice(meta->audioDeviceID);
-    delete[] meta->data;
+    SDL_PauseAudioDevice(m_deviceID, 0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stopCondition.wait(lock, [this]() { return m_stopped; });
+    lock.unlock();
+
+    SDL_PauseAudioDevice(m_deviceID, 1);
+    return 0;
 }
 
-bool audio::sdl::openOutputDevice(AudioMetadataPtr meta)
+void CaptureSource::stop()
 {
-    std::lock_guard<std::mutex>(meta->mutex);
-    SDL_AudioSpec have;
-    SDL_AudioSpec want;
-    SDL_zero(want); // O rly?
-    want.freq = meta->fileSpec.freq;
-    want.format = meta->fileSpec.format;
-    want.channels = meta->fileSpec.channels;
-    want.callback = &outputCallback;
-    want.userdata = meta.get();
-
-    meta->audioDeviceID = SDL_OpenAudioDevice(meta->audioDevice.c_str(), false, &want, &have, 0);
-    if (meta->audioDeviceID == 0) {
-        return false;
-    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopped = true;
+    m_stopCondition.notify_all();
+}
 
-    SDL_Log("Want Freq: %i Format: 0x%0i Samples: %i Channels: %i", want.freq, want.format, want.samples, want.channels);
-    SDL_Log("Have Freq: %i Format: 0x%0i Samples: %i Channels: %i", have.freq, have.format, have.samples, have.channels);
+// FileSource
+// ==========
 
-    SDL_PauseAudioDevice(meta->audioDeviceID, 0);
-    return true;
+FileSource::FileSource(const std::string &file, const std::string &device, const bool playback)
+    : m_file(file)
+    , m_device(device)
+    , m_playback(playback)
+{
+    SDL_zero(m_spec);
 }
 
-void audio::sdl::closeOutputDevice(AudioMetadataPtr meta)
+FileSource::~FileSource()
 {
-    std::lock_guard<std::mutex>(meta->mutex);
-    SDL_PauseAudioDevice(meta->audioDeviceID, 1);
-    SDL_CloseAudioDevice(meta->audioDeviceID);
-    SDL_FreeWAV(meta->data);
+    if (m_deviceID != 0) {
+        SDL_PauseAudioDevice(m_deviceID, 1);
+        SDL_CloseAudioDevice(m_deviceID);
+    }
+
+    if (m_data) {
+        SDL_FreeWAV(m_data);
+    }
 }
 
-bool audio::sdl::loadFile(AudioMetadataPtr meta)
+void FileSource::callback(void *userData, uint8_t *stream, int bufferSize)
 {
-    //std::lock_guard<std::mutex>(meta->mutex);
-    meta->mutex.lock();
-    if (SDL_LoadWAV(meta->inputFile.c_str(), &meta->fileSpec, &meta->data, &meta->dataSize) == 0) {
+    FileSource *source = reinterpret_cast<FileSource *>(userData);
+    std::lock_guard<std::mutex> lock(source->m_mutex);
+    const uint32_t count = std::min(static_cast<uint32_t>(bufferSize),
+                                    source->m_dataSize - source->m_position);
+    memcpy(stream, &source->m_data[source->m_position], count);
+    memset(&stream[count], source->m_spec.silence, bufferSize - count);
+
+    const int frameSize = sizeof(int16_t) * source->format().channels;
+    source->deliver(reinterpret_cast<int16_t *>(&source->m_data[source->m_position]), count / frameSize);
+    //SDL_Log("Audio pos: %f", source->m_position / (float)source->m_dataSize);
+    source->m_position += count;
+
+    if (source->m_position >= source->m_dataSize) {
+        source->m_stopped = true;
+        source->m_stopCondition.notify_all();
+    }
+}
+
+bool FileSource::open()
+{
+    if (SDL_LoadWAV(m_file.c_str(), &m_spec, &m_data, &m_dataSize) == nullptr) {
+        SDL_Log("Error loading \"%s\": %s", m_file.c_str(), SDL_GetError());
         return false;
     }
 
-    if (SDL_AUDIO_BITSIZE(meta->fileSpec.format) != 16
-        || !SDL_AUDIO_ISLITTLEENDIAN(meta->fileSpec.format)
-        || !SDL_AUDIO_ISSIGNED(meta->fileSpec.format)) {
+    if (SDL_AUDIO_BITSIZE(m_spec.format) != 16
+        || !SDL_AUDIO_ISLITTLEENDIAN(m_spec.format)
+        || !SDL_AUDIO_ISSIGNED(m_spec.format)) {
         SDL_Log("Input is not S16LE wav!");
-        // Set SDL-internal error here?
         return false;
     }
 
     // Data is stored as uint8_t but might actually be int16_t, thus dataSize
     // needs to be divided by 2 to get the sample count.
-    const int sampleSizeFactor = SDL_AUDIO_BITSIZE(meta->fileSpec.format) / 8;
-    meta->duration = (float)meta->dataSize / sampleSizeFactor / (float)meta->fileSpec.channels / (float)meta->fileSpec.freq;
-
-    /*SDL_Log("SDL says freq: %i format: %i channels: %i samples: %i",
-            meta->fileSpec.freq,
-            meta->fileSpec.format,
-            meta->fileSpec.channels,
-            meta->fileSpec.samples);*/
+    const int sampleSizeFactor = SDL_AUDIO_BITSIZE(m_spec.format) / 8;
+    Format format;
+    format.rate = m_spec.freq;
+    format.channels = m_spec.channels;
+    format.duration = (float)m_dataSize / sampleSizeFactor / (float)m_spec.channels / (float)m_spec.freq;
+
     SDL_Log("Length: %f s (%i bytes) sample size: %i LE: %i",
-            meta->duration,
-            meta->dataSize,
-            SDL_AUDIO_MASK_BITSIZE & meta->fileSpec.format,
-            SDL_AUDIO_ISLITTLEENDIAN(meta->fileSpec.format));
-    meta->mutex.unlock();
+            format.duration,
+            m_dataSize,
+            SDL_AUDIO_MASK_BITSIZE & m_spec.format,
+            SDL_AUDIO_ISLITTLEENDIAN(m_spec.format));
+
+    if (!m_playback) {
+        format.latency = 0;
+        setFormat(format);
+        return true;
+    }
+
+    SDL_AudioSpec have;
+    SDL_AudioSpec want;
+    SDL_zero(want); // O rly?
+    want.freq = m_spec.freq;
+    want.format = m_spec.format;
+    want.channels = m_spec.channels;
+    want.callback = &FileSource::callback;
+    want.userdata = this;
+
+    // Formats must match exactly, the callback copies the file data verbatim.
+    m_deviceID = SDL_OpenAudioDevice(m_device.empty() ? nullptr : m_device.c_str(), false, &want, &have, 0);
+    if (m_deviceID == 0) {
+        SDL_Log("Error opening audio device \"%s\": %s", m_device.c_str(), SDL_GetError());
+        return false;
+    }
+
+    SDL_Log("Want Freq: %i Format: 0x%0i Samples: %i Channels: %i", want.freq, want.format, want.samples, want.channels);
+    SDL_Log("Have Freq: %i Format: 0x%0i Samples: %i Channels: %i", have.freq, have.format, have.samples, have.channels);
+
+    format.latency = have.samples / static_cast<float>(have.freq);
+    setFormat(format);
     return true;
 }
+
+int FileSource::run()
+{
+    SDL_PauseAudioDevice(m_deviceID, 0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stopCondition.wait(lock, [this]() { return m_stopped; });
+    lock.unlock();
+
+    SDL_PauseAudioDevice(m_deviceID, 1);
+    return 0;
+}
+
+size_t FileSource::read(int16_t dst[], const size_t frameCount)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint32_t frameSize = sizeof(int16_t) * format().channels;
+    const uint32_t count = std::min(static_cast<uint32_t>(frameCount * frameSize),
+                                    (m_dataSize - m_position) / frameSize * frameSize);
+    memcpy(dst, &m_data[m_position], count);
+    m_position += count;
+    return count / frameSize;
+}
+
+void FileSource::stop()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopped = true;
+    m_stopCondition.notify_all();
+}
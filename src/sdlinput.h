@@ -1,7 +1,13 @@
 #ifndef SDLINPUT
 #define SDLINPUT
 
-#include "audiometadata.h"
+#include "audiosource.h"
+
+#include <SDL_audio.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
 
 namespace groggle
 {
@@ -10,11 +16,68 @@ namespace audio
 namespace sdl
 {
 
-bool openInputDevice(AudioMetadataPtr meta);
-void closeInputDevice(AudioMetadataPtr meta);
-bool openOutputDevice(AudioMetadataPtr meta);
-void closeOutputDevice(AudioMetadataPtr meta);
-bool loadFile(AudioMetadataPtr meta);
+/**
+ * Records from an SDL capture device.
+ */
+class CaptureSource : public AudioSource
+{
+public:
+    CaptureSource(const std::string &device);
+    ~CaptureSource();
+
+    bool open() override;
+    int run() override;
+    void stop() override;
+    std::string name() const override { return "SDL capture \"" + m_device + "\""; }
+    bool deliversFromRun() const override { return false; }
+
+private:
+    static void callback(void *userData, uint8_t *stream, int bufferSize);
+
+    const std::string m_device;
+    SDL_AudioDeviceID m_deviceID = 0;
+    std::mutex m_mutex;
+    std::condition_variable m_stopCondition;
+    bool m_stopped = false;
+};
+
+/**
+ * Plays a WAV file on an SDL output device and feeds the analysis with
+ * whatever is currently being played.
+ */
+class FileSource : public AudioSource
+{
+public:
+    /**
+     * @param playback Whether to open the output device. Without playback,
+     * the file can only be read().
+     */
+    FileSource(const std::string &file, const std::string &device, const bool playback = true);
+    ~FileSource();
+
+    bool open() override;
+    int run() override;
+    void stop() override;
+    std::string name() const override { return "WAV file \"" + m_file + "\""; }
+    bool deliversFromRun() const override { return false; }
+    size_t read(int16_t dst[], const size_t frameCount) override;
+
+private:
+    static void callback(void *userData, uint8_t *stream, int bufferSize);
+
+    const std::string m_file;
+    const std::string m_device;
+    const bool m_playback;
+    SDL_AudioDeviceID m_deviceID = 0;
+    SDL_AudioSpec m_spec;
+    uint8_t *m_data = nullptr;
+    uint32_t m_dataSize = 0;
+    uint32_t m_position = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_stopCondition;
+    bool m_stopped = false;
+};
 
 }
 }
@@ -0,0 +1,103 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace groggle
+{
+
+/**
+ * A small value shared between threads without a mutex. Writers are rare and
+ * take turns on a sequence number that is odd while one of them stores.
+ * Readers copy the value and try again if the sequence changed meanwhile.
+ *
+ * Readers never block, but they do spin while a writer is between its stores,
+ * so a writer preempted right there holds them up until it runs again. That
+ * window is kept down to the stores themselves, everything a writer computes
+ * happens before it.
+ *
+ * The value lives in atomic words, which keeps the copies free of data races
+ * as far as the language is concerned. T must be trivially copyable.
+ */
+template <typename T>
+class Seqlock
+{
+public:
+    Seqlock(const T &value = T()) { store(value); }
+
+    T load() const {
+        uint64_t words[WORDS];
+        uint32_t before = 0;
+        uint32_t after = 0;
+        do {
+            before = m_sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; i++) {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    void store(const T &value) {
+        update([&value](T &current) { current = value; });
+    }
+
+    /**
+     * Changes part of the value. modify works on a copy before the write
+     * begins. If another writer got in first meanwhile, modify runs again on
+     * that writer's result, so it should do nothing but change the value.
+     */
+    template <typename F>
+    void update(F modify) {
+        uint64_t words[WORDS] = {};
+        uint32_t sequence = 0;
+        while (true) {
+            // A read like load(), validated by the compare and swap below
+            sequence = m_sequence.load(std::memory_order_acquire);
+            if (sequence & 1) {
+                continue;
+            }
+            for (size_t i = 0; i < WORDS; i++) {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            T value;
+            memcpy(&value, words, sizeof(T));
+            modify(value);
+            memcpy(words, &value, sizeof(T));
+
+            if (m_sequence.compare_exchange_weak(sequence, sequence + 1,
+                                                 std::memory_order_acquire, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        // Odd from here on, readers spin
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++) {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+private:
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock values are copied bytewise");
+    static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> m_sequence { 0 };
+    std::atomic<uint64_t> m_words[WORDS] = {};
+};
+
+}
+
+#endif
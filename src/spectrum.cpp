@@ -1,9 +1,56 @@
 #include "spectrum.h"
 
+#include <algorithm> // min, max
+
 namespace groggle
 {
 namespace audio
 {
 
+Spectrum mix(const Spectrum &a, const Spectrum &b, const float t)
+{
+    const size_t size = std::min(a.size(), b.size());
+    Spectrum result(size);
+    for (size_t i = 0; i < size; i++) {
+        const float blend = a[i] + (b[i] - a[i]) * t;
+        result[i] = std::min(std::max(blend, 0.0f), std::max(a[i], b[i]));
+    }
+    return result;
+}
+
+void SpectrumInterpolator::push(const uint64_t timestamp, const Spectrum &spectrum)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_times[0] = m_times[1];
+    m_frames[0].swap(m_frames[1]);
+    m_times[1] = timestamp;
+    m_frames[1] = spectrum;
+    m_count = std::min(m_count + 1, 2);
+}
+
+bool SpectrumInterpolator::at(const uint64_t timestamp, Spectrum *spectrum) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_count == 0) {
+        return false;
+    }
+
+    if (m_count == 1 || m_times[1] <= m_times[0]) {
+        *spectrum = m_frames[1];
+        return true;
+    }
+
+    if (timestamp <= m_times[0]) {
+        *spectrum = m_frames[0];
+        return true;
+    }
+
+    // Past the newer frame, t > 1 extrapolates falling magnitudes. Only trust
+    // the trend for one interval, the next frame is overdue by then.
+    const float t = (timestamp - m_times[0]) / static_cast<float>(m_times[1] - m_times[0]);
+    *spectrum = mix(m_frames[0], m_frames[1], std::min(t, 2.0f));
+    return true;
+}
+
 }
 }
@@ -1,7 +1,9 @@
 #ifndef SPECTRUM
 #define SPECTRUM
 
+#include <cstdint>
 #include <deque>
+#include <mutex>
 
 namespace groggle
 {
@@ -10,6 +12,34 @@ namespace audio
 
 typedef std::deque<float> Spectrum;
 
+/**
+ * Linear blend of two spectra, a at t = 0 and b at t = 1. t outside of [0, 1]
+ * extrapolates, clamped to between 0 and the larger of the two magnitudes:
+ * a decay may continue, a rise never overshoots.
+ */
+Spectrum mix(const Spectrum &a, const Spectrum &b, const float t);
+
+/**
+ * Resamples analysis frames to another rate. Keeps the two latest frames and
+ * blends between them, or continues their decay past the latest one for up
+ * to one frame interval. Thread safe.
+ */
+class SpectrumInterpolator
+{
+public:
+    /// @param timestamp ns, must not decrease between calls
+    void push(const uint64_t timestamp, const Spectrum &spectrum);
+
+    /// @return false if there is no frame yet
+    bool at(const uint64_t timestamp, Spectrum *spectrum) const;
+
+private:
+    mutable std::mutex m_mutex;
+    uint64_t m_times[2] = { 0, 0 };
+    Spectrum m_frames[2]; // Older, newer
+    int m_count = 0;
+};
+
 }
 }
 
@@ -0,0 +1,86 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace groggle
+{
+
+/**
+ * Bounded lock-free queue between exactly one producer and one consumer
+ * thread. Slots are allocated up front and recycled.
+ *
+ * A full queue rejects push(), so the producer decides between waiting
+ * (back-pressure) and dropping its value. Consumers that only care about the
+ * newest value use popLatest(), which drops the oldest ones.
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+    SpscQueue(const size_t capacity)
+        : m_slots(capacity + 1) // One slot stays empty to tell full from empty
+    {}
+
+    size_t capacity() const { return m_slots.size() - 1; }
+
+    /// Producer only. @return false if the queue is full
+    bool push(T value) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t next = (tail + 1) % m_slots.size();
+        if (next == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        m_slots[tail] = std::move(value);
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer only. @return false if the queue is empty
+    bool pop(T *value) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        *value = std::move(m_slots[head]);
+        m_head.store((head + 1) % m_slots.size(), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer only. Empties the queue, keeping only the newest value.
+     * @param dropped Incremented by the number of older values skipped
+     * @return false if the queue was empty
+     */
+    bool popLatest(T *value, size_t *dropped = nullptr) {
+        if (!pop(value)) {
+            return false;
+        }
+
+        while (pop(value)) {
+            if (dropped) {
+                (*dropped)++;
+            }
+        }
+        return true;
+    }
+
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> m_slots;
+    // Separate cache lines, producer and consumer each write one of them
+    alignas(64) std::atomic<size_t> m_head { 0 }; // Next slot to pop
+    alignas(64) std::atomic<size_t> m_tail { 0 }; // Next slot to push
+};
+
+}
+
+#endif
@@ -1,7 +1,41 @@
 #define CATCH_CONFIG_MAIN
 #include "catch2/catch_amalgamated.hpp"
 
+#include "analysiscache.h"
+#include "asyncsink.h"
+#include "changefilter.h"
 #include "color.h"
+#include "colorfade.h"
+#include "cuefile.h"
+#include "cuesink.h"
+#include "effects.h"
+#include "eventloop.h"
+#include "generator.h"
+#include "governor.h"
+#include "mailbox.h"
+#include "netdmx.h"
+#include "patch.h"
+#include "pixelmap.h"
+#include "realtime.h"
+#include "samplebuffer.h"
+#include "seqlock.h"
+#include "spscqueue.h"
+#include "spectrum.h"
+#include "timer.h"
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
 
 TEST_CASE("Color black", "[color]")
 {
@@ -46,3 +80,1066 @@ TEST_CASE( "Color blue", "[color]")
     REQUIRE(color.g() == 0);
     REQUIRE(color.b() == 1);
 }
+
+TEST_CASE("Colors convert in batches", "[color]")
+{
+    using namespace groggle;
+    // 7 colors: one vector and a scalar rest
+    const float h[7] = { 0, 30, 120, 180, 240, 300, 359 };
+    const float s[7] = { 1, 1, 1, 0.5f, 1, 0, 0.25f };
+    const float v[7] = { 1, 0.5f, 1, 1, 0.25f, 0.75f, 1 };
+    float r[7];
+    float g[7];
+    float b[7];
+    hsvToRgb(h, s, v, r, g, b, 7);
+    REQUIRE(r[1] == Catch::Approx(0.5f));
+    REQUIRE(g[1] == Catch::Approx(0.25f));
+    REQUIRE(b[1] == Catch::Approx(0));
+    REQUIRE(r[3] == Catch::Approx(0.5f));
+    REQUIRE(g[3] == Catch::Approx(1));
+    REQUIRE(b[4] == Catch::Approx(0.25f));
+    REQUIRE(g[5] == Catch::Approx(0.75f));
+
+    float tableR[7];
+    float tableG[7];
+    float tableB[7];
+    hsvToRgbTable(h, s, v, tableR, tableG, tableB, 7);
+    float hue[7];
+    float saturation[7];
+    float value[7];
+    rgbToHsv(r, g, b, hue, saturation, value, 7);
+    for (size_t i = 0; i < 7; i++) {
+        const Color color(h[i], s[i], v[i]);
+        CHECK(color.r() == r[i]);
+        CHECK(color.b() == b[i]);
+        CHECK(tableG[i] == Catch::Approx(g[i]).margin(0.001));
+        CHECK(hue[i] == Catch::Approx(s[i] > 0 ? h[i] : 0).margin(0.01));
+        CHECK(saturation[i] == Catch::Approx(s[i]));
+        CHECK(value[i] == Catch::Approx(v[i]));
+    }
+
+    // Copies keep the RGB form
+    Color color(200, 0.5f, 0.5f);
+    const Color copy = color;
+    color = Color(0, 1, 1);
+    REQUIRE(copy.b() == Catch::Approx(0.5f));
+    REQUIRE(color.r() == 1);
+}
+
+TEST_CASE("Color fades go through OKLCh", "[color]")
+{
+    using namespace groggle;
+    const float white[3] = { 1, 1, 1 };
+    float lab[3];
+    rgbToOklab(white, lab);
+    REQUIRE(lab[0] == Catch::Approx(1).margin(0.001));
+    REQUIRE(lab[1] == Catch::Approx(0).margin(0.001));
+    REQUIRE(lab[2] == Catch::Approx(0).margin(0.001));
+
+    const float orange[3] = { 1, 0.5f, 0 };
+    float back[3];
+    rgbToOklab(orange, lab);
+    oklabToRgb(lab, back);
+    REQUIRE(back[1] == Catch::Approx(0.5f).margin(0.001));
+
+    // Red to blue the short way, through magenta rather than green
+    const float red[3] = { 1, 0, 0 };
+    const float blue[3] = { 0, 0, 1 };
+    ColorFade fade;
+    fade.start(red, blue, 2);
+    REQUIRE_FALSE(fade.isDone());
+    float rgb[3];
+    fade.advance(1, rgb);
+    REQUIRE(rgb[0] > 0.3f);
+    REQUIRE(rgb[1] < 0.1f);
+    REQUIRE(rgb[2] > 0.3f);
+    fade.advance(1.5f, rgb);
+    REQUIRE(fade.isDone());
+    REQUIRE(rgb[0] == 0);
+    REQUIRE(rgb[2] == 1);
+
+    // From black the hue stays that of the target
+    const float black[3] = {};
+    fade.start(black, orange, 1);
+    const float progress[3] = { 0, 0.5f, 1 };
+    float r[3];
+    float g[3];
+    float b[3];
+    fade.sample(progress, r, g, b, 3);
+    REQUIRE(r[0] == 0);
+    REQUIRE(g[1] / r[1] == Catch::Approx(0.5f).margin(0.05));
+    REQUIRE(b[1] < 0.01f);
+    REQUIRE(g[2] == 0.5f);
+
+    fade.start(black, orange, 0);
+    REQUIRE(fade.isDone());
+}
+
+TEST_CASE("Color conversion speed", "[.][benchmark]")
+{
+    using namespace groggle;
+    const size_t count = 10000;
+    std::vector<float> h(count);
+    std::vector<float> s(count, 1.0f);
+    std::vector<float> v(count, 0.5f);
+    std::vector<float> r(count);
+    std::vector<float> g(count);
+    std::vector<float> b(count);
+    for (size_t i = 0; i < count; i++) {
+        h[i] = i * 360.0f / count;
+    }
+
+    BENCHMARK("Color, one by one") {
+        float sum = 0;
+        for (size_t i = 0; i < count; i++) {
+            sum += Color(h[i], s[i], v[i]).g();
+        }
+        return sum;
+    };
+    BENCHMARK("hsvToRgb") {
+        hsvToRgb(h.data(), s.data(), v.data(), r.data(), g.data(), b.data(), count);
+        return g[count / 2];
+    };
+    BENCHMARK("hsvToRgbTable") {
+        hsvToRgbTable(h.data(), s.data(), v.data(), r.data(), g.data(), b.data(), count);
+        return g[count / 2];
+    };
+    BENCHMARK("rgbToHsv") {
+        rgbToHsv(r.data(), g.data(), b.data(), h.data(), s.data(), v.data(), count);
+        return s[count / 2];
+    };
+}
+
+TEST_CASE("SampleBuffer wraps around", "[audio]")
+{
+    groggle::audio::SampleBuffer buffer(4, 2);
+    int16_t latest[8] = {};
+    REQUIRE(buffer.latest(latest, 4) == 0);
+
+    const int16_t first[] = { 1, -1, 2, -2, 3, -3 };
+    buffer.push(first, 3);
+    REQUIRE(buffer.latest(latest, 4) == 3);
+    REQUIRE(latest[0] == 1);
+    REQUIRE(latest[5] == -3);
+
+    const int16_t second[] = { 4, -4, 5, -5, 6, -6 };
+    buffer.push(second, 3);
+    REQUIRE(buffer.written() == 6);
+    REQUIRE(buffer.latest(latest, 4) == 4);
+    REQUIRE(latest[0] == 3);
+    REQUIRE(latest[1] == -3);
+    REQUIRE(latest[6] == 6);
+    REQUIRE(latest[7] == -6);
+}
+
+TEST_CASE("SampleBuffer wakes up waiters once enough arrived", "[audio]")
+{
+    groggle::audio::SampleBuffer buffer(16, 1);
+    REQUIRE_FALSE(buffer.waitFor(4, std::chrono::milliseconds(1)));
+
+    const int16_t samples[] = { 1, 2, 3 };
+    std::thread producer([&buffer, &samples]() {
+        buffer.push(samples, 3);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        buffer.push(samples, 3);
+    });
+    REQUIRE(buffer.waitFor(4, std::chrono::seconds(5)));
+    REQUIRE(buffer.written() >= 4);
+    producer.join();
+
+    // Closing releases waiters that will never be satisfied
+    std::thread closer([&buffer]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        buffer.close();
+    });
+    REQUIRE_FALSE(buffer.waitFor(100, std::chrono::seconds(5)));
+    REQUIRE(buffer.isClosed());
+    closer.join();
+}
+
+TEST_CASE("SampleBuffer tells sound from silence", "[audio]")
+{
+    groggle::audio::SampleBuffer buffer(16, 2);
+    buffer.setSilenceThreshold(10);
+
+    const int16_t quiet[] = { 3, -10, 0, 7 };
+    const int16_t loud[] = { 0, 0, -11, 0 };
+    buffer.push(quiet, 2);
+    REQUIRE(buffer.lastSound() == 0);
+    REQUIRE_FALSE(buffer.waitForSound(0, std::chrono::milliseconds(1)));
+
+    std::thread producer([&buffer, &quiet, &loud]() {
+        buffer.push(quiet, 2);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        buffer.push(loud, 2);
+    });
+    REQUIRE(buffer.waitForSound(0, std::chrono::seconds(5)));
+    producer.join();
+    REQUIRE(buffer.lastSound() == 6);
+}
+
+TEST_CASE("Seqlock readers never see half a write", "[pipeline]")
+{
+    struct Pair
+    {
+        uint32_t a = 0;
+        float b = 0;
+        uint8_t c = 0; // Leaves the last word partly used
+    };
+    groggle::Seqlock<Pair> lock;
+    REQUIRE(lock.load().a == 0);
+    lock.update([](Pair &pair) { pair.c = 7; });
+    REQUIRE(lock.load().c == 7);
+
+    const uint32_t count = 100000;
+    std::thread writer([&lock]() {
+        for (uint32_t i = 1; i <= count; i++) {
+            lock.update([i](Pair &pair) {
+                pair.a = i;
+                pair.b = i;
+            });
+        }
+    });
+
+    uint32_t last = 0;
+    bool torn = false;
+    bool backwards = false;
+    while (last < count) {
+        const Pair pair = lock.load();
+        torn |= pair.b != pair.a || pair.c != 7;
+        backwards |= pair.a < last;
+        last = pair.a;
+    }
+    writer.join();
+    REQUIRE_FALSE(torn);
+    REQUIRE_FALSE(backwards);
+
+    // Writers racing each other lose no updates
+    const auto increment = [&lock]() {
+        for (uint32_t i = 0; i < count; i++) {
+            lock.update([](Pair &pair) { pair.a++; });
+        }
+    };
+    std::thread other(increment);
+    increment();
+    other.join();
+    REQUIRE(lock.load().a == 3 * count);
+}
+
+TEST_CASE("SpscQueue keeps order across threads", "[pipeline]")
+{
+    groggle::SpscQueue<int> queue(4);
+    REQUIRE(queue.capacity() == 4);
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(queue.push(i));
+    }
+    REQUIRE_FALSE(queue.push(4)); // Full, the producer decides
+
+    int value = -1;
+    size_t dropped = 0;
+    REQUIRE(queue.popLatest(&value, &dropped));
+    REQUIRE(value == 3);
+    REQUIRE(dropped == 3);
+    REQUIRE(queue.empty());
+    REQUIRE_FALSE(queue.pop(&value));
+
+    const int count = 100000;
+    std::thread producer([&queue]() {
+        for (int i = 0; i < count; i++) {
+            while (!queue.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int expected = 0;
+    int outOfOrder = 0;
+    while (expected < count) {
+        if (queue.pop(&value)) {
+            outOfOrder += value != expected;
+            expected++;
+        } else {
+            std::this_thread::yield(); // The producer may share our core
+        }
+    }
+    producer.join();
+    REQUIRE(outOfOrder == 0);
+}
+
+TEST_CASE("Mailboxes hand over the newest value", "[pipeline]")
+{
+    groggle::Mailbox<std::vector<int>> mailbox;
+    std::vector<int> value;
+    REQUIRE_FALSE(mailbox.take(&value));
+
+    REQUIRE(mailbox.put({ 1 }));
+    REQUIRE_FALSE(mailbox.put({ 2 })); // Replaces the unread 1
+    REQUIRE(mailbox.take(&value));
+    REQUIRE(value == std::vector<int> { 2 });
+    REQUIRE_FALSE(mailbox.take(&value));
+
+    // Values arrive whole and never go back in time
+    const int count = 100000;
+    std::thread producer([&mailbox]() {
+        for (int i = 1; i <= count; i++) {
+            mailbox.put(std::vector<int>(4, i));
+        }
+    });
+
+    int last = 0;
+    bool torn = false;
+    bool backwards = false;
+    while (last < count) {
+        if (mailbox.take(&value)) {
+            torn |= std::count(value.begin(), value.end(), value.front()) != 4;
+            backwards |= value.front() <= last;
+            last = value.front();
+        }
+    }
+    producer.join();
+    REQUIRE_FALSE(torn);
+    REQUIRE_FALSE(backwards);
+}
+
+TEST_CASE("Spectra are interpolated between analysis frames", "[audio]")
+{
+    groggle::audio::SpectrumInterpolator interpolator;
+    groggle::audio::Spectrum spectrum;
+    REQUIRE_FALSE(interpolator.at(0, &spectrum));
+
+    interpolator.push(1000, { 0.0f, 1.0f });
+    REQUIRE(interpolator.at(5000, &spectrum));
+    REQUIRE(spectrum.at(1) == 1.0f);
+
+    interpolator.push(2000, { 1.0f, 0.5f });
+    REQUIRE(interpolator.at(500, &spectrum));
+    REQUIRE(spectrum.at(0) == 0.0f);
+    REQUIRE(interpolator.at(1500, &spectrum));
+    REQUIRE(spectrum.at(0) == Catch::Approx(0.5f));
+    REQUIRE(spectrum.at(1) == Catch::Approx(0.75f));
+
+    // Extrapolation follows a decay for one interval, never below zero, and
+    // holds a rise at the newest magnitude
+    REQUIRE(interpolator.at(2500, &spectrum));
+    REQUIRE(spectrum.at(0) == 1.0f);
+    REQUIRE(spectrum.at(1) == Catch::Approx(0.25f));
+    REQUIRE(interpolator.at(9000, &spectrum));
+    REQUIRE(spectrum.at(0) == 1.0f);
+    REQUIRE(spectrum.at(1) == 0.0f);
+}
+
+TEST_CASE("Generator is deterministic", "[generator]")
+{
+    groggle::audio::Generator::Params params;
+    REQUIRE(groggle::audio::Generator::parse("pink,seed=42,amp=1", &params));
+    REQUIRE(params.signal == groggle::audio::Generator::Signal::PINK_NOISE);
+    REQUIRE(params.seed == 42);
+
+    groggle::audio::Generator a(params);
+    groggle::audio::Generator b(params);
+    int16_t bufA[512];
+    int16_t bufB[512];
+    a.render(bufA, 512);
+    b.render(bufB, 512);
+    REQUIRE(std::equal(bufA, bufA + 512, bufB));
+    REQUIRE(a.position() == 512);
+
+    REQUIRE_FALSE(groggle::audio::Generator::parse("triangle", &params));
+    REQUIRE_FALSE(groggle::audio::Generator::parse("sine,freq", &params));
+
+    // Seeds beyond a float's precision stay exact
+    REQUIRE(groggle::audio::Generator::parse("pink,seed=16777217", &params));
+    REQUIRE(params.seed == 16777217u);
+    REQUIRE(groggle::audio::Generator::parse("pink,seed=4294967295", &params));
+    REQUIRE(params.seed == 4294967295u);
+    REQUIRE_FALSE(groggle::audio::Generator::parse("pink,seed=4294967296", &params));
+    REQUIRE_FALSE(groggle::audio::Generator::parse("pink,seed=1.5", &params));
+    REQUIRE_FALSE(groggle::audio::Generator::parse("pink,seed=-1", &params));
+    REQUIRE_FALSE(groggle::audio::Generator::parse("sine,duration=-1", &params));
+    REQUIRE_FALSE(groggle::audio::Generator::parse("sine,speed=-2", &params));
+    REQUIRE_FALSE(groggle::audio::Generator::parse("sine,amp=1.5", &params));
+    REQUIRE_FALSE(groggle::audio::Generator::parse("sine,amp=nan", &params));
+    REQUIRE_FALSE(groggle::audio::Generator::parse("clicks,bpm=0", &params));
+}
+
+TEST_CASE("Generator clicks on the beat", "[generator]")
+{
+    groggle::audio::Generator::Params params;
+    REQUIRE(groggle::audio::Generator::parse("clicks,bpm=120,rate=8000,amp=1", &params));
+    groggle::audio::Generator generator(params);
+
+    // 120 BPM at 8 kHz: a 5 ms (40 frames) click every 4000 frames
+    int16_t samples[12000];
+    generator.render(samples, 12000);
+    for (int beat = 0; beat < 3; beat++) {
+        const int16_t *start = &samples[beat * 4000];
+        REQUIRE(std::any_of(start, start + 40, [](int16_t s) { return s != 0; }));
+        REQUIRE(std::all_of(start + 40, start + 4000, [](int16_t s) { return s == 0; }));
+    }
+}
+
+TEST_CASE("Cue files round trip", "[cue]")
+{
+    const std::string path = "test_roundtrip.cue";
+    {
+        // Sync point every 100 ms
+        groggle::cue::Writer writer(path, 100 * 1000 * 1000);
+        REQUIRE(writer.isOpen());
+        uint8_t channels[512] = {};
+        for (uint64_t i = 0; i < 100; i++) {
+            channels[0] = 255;
+            channels[69] = i;
+            REQUIRE(writer.write(i * 33333333ull, 1, channels, 512));
+            REQUIRE(writer.write(i * 33333333ull, 2, channels, 70));
+        }
+        REQUIRE(writer.close());
+    }
+
+    groggle::cue::Reader reader(path);
+    REQUIRE(reader.isOpen());
+    REQUIRE(reader.frameCount() >= 200);
+    REQUIRE(reader.duration() == 99 * 33333333ull);
+
+    groggle::cue::Frame frame;
+    REQUIRE(reader.next(&frame));
+    REQUIRE(frame.timestamp == 0);
+    REQUIRE(frame.universe == 1);
+    REQUIRE(frame.channels[0] == 255);
+    REQUIRE(frame.channels[69] == 0);
+
+    // Lands between sync points, deltas have to be replayed
+    reader.seek(50 * 33333333ull);
+    REQUIRE(reader.next(&frame));
+    REQUIRE(frame.timestamp == 50 * 33333333ull);
+    REQUIRE(frame.universe == 1);
+    REQUIRE(frame.channels[0] == 255);
+    REQUIRE(frame.channels[69] == 50);
+    REQUIRE(frame.channels[511] == 0);
+
+    uint64_t count = 1;
+    while (reader.next(&frame)) {
+        count++;
+    }
+    REQUIRE(frame.timestamp == 99 * 33333333ull);
+    REQUIRE(frame.channels[69] == 99);
+    REQUIRE(count >= 100);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Cue files can be written in large chunks", "[cue]")
+{
+    const std::string path = "/tmp/groggle-test-buffered.cue";
+    const size_t frames = 16;
+    groggle::cue::Writer writer(path, 1000 * 1000 * 1000, frames * 2 * groggle::cue::MAX_RECORD_SIZE);
+    REQUIRE(writer.isOpen());
+    uint8_t channels[512] = {};
+    for (uint64_t i = 0; i < frames; i++) {
+        channels[i] = 255;
+        REQUIRE(writer.write(i * 22727272ull, 1, channels, 512));
+        REQUIRE(writer.write(i * 22727272ull, 2, channels, 512));
+    }
+
+    // Still all in the buffer
+    struct stat status;
+    REQUIRE(stat(path.c_str(), &status) == 0);
+    REQUIRE(status.st_size == 0);
+
+    REQUIRE(writer.close());
+    groggle::cue::Reader reader(path);
+    REQUIRE(reader.frameCount() == 2 * frames);
+    REQUIRE(reader.duration() == (frames - 1) * 22727272ull);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Live cue recordings are readable once the sink is closed", "[cue]")
+{
+    const std::string path = "/tmp/groggle-test-recording.cue";
+    uint64_t now = 0;
+    auto recorder = std::make_shared<groggle::CueSink>(path, [&now]() { return now; }, 4 * groggle::cue::MAX_RECORD_SIZE);
+    REQUIRE(recorder->isOpen());
+    groggle::AsyncSink sender(recorder);
+
+    groggle::DmxFrame frame;
+    frame.universes = { 1, 2 };
+    frame.channels.resize(2 * groggle::UNIVERSE_SIZE);
+    for (uint64_t i = 0; i < 10; i++) {
+        frame.channels[0] = i;
+        REQUIRE(sender.sendFrame(frame));
+        REQUIRE(sender.flush(std::chrono::seconds(1)));
+        now += 22727272ull;
+    }
+
+    // Still referenced, like by the MQTT thread at exit
+    REQUIRE(sender.close());
+    groggle::cue::Reader reader(path);
+    REQUIRE(reader.isOpen());
+    REQUIRE(reader.frameCount() == 20);
+    REQUIRE(reader.duration() == 9 * 22727272ull);
+
+    groggle::cue::Frame read;
+    reader.seek(9 * 22727272ull);
+    REQUIRE(reader.next(&read));
+    REQUIRE(read.universe == 1);
+    REQUIRE(read.channels[0] == 9);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Analysis cache is keyed by content and params", "[cache]")
+{
+    char directory[] = "/tmp/groggle-test-XXXXXX";
+    REQUIRE(mkdtemp(directory));
+    groggle::audio::AnalysisCache cache(std::string(directory) + "/cache");
+
+    groggle::audio::SeriesParams params;
+    params.frameSize = 8;
+    params.binCount = 4;
+    params.tickRate = 10;
+    REQUIRE_FALSE(cache.find(42, params));
+
+    {
+        auto writer = cache.create(42, params);
+        REQUIRE(writer);
+        REQUIRE(writer->append(groggle::audio::Spectrum { 1, 2, 3, 4 }));
+        REQUIRE(writer->append(groggle::audio::Spectrum { 5, 6 }));
+        REQUIRE(writer->commit());
+    }
+
+    auto series = cache.find(42, params);
+    REQUIRE(series);
+    REQUIRE(series->frameCount() == 2);
+    REQUIRE(series->at(0).at(0) == 1); // Before the first tick
+    REQUIRE(series->at(150 * 1000 * 1000).at(3) == 4);
+    REQUIRE(series->at(200 * 1000 * 1000).at(1) == 6);
+    REQUIRE(series->at(200 * 1000 * 1000).at(3) == 0);
+    REQUIRE(series->at(60ull * 1000 * 1000 * 1000).at(0) == 5); // Past the end
+
+    REQUIRE_FALSE(cache.find(43, params));
+    params.tickRate = 30;
+    REQUIRE_FALSE(cache.find(42, params));
+
+    // The series file is all there is to clean up
+    const std::string cacheDirectory = std::string(directory) + "/cache";
+    DIR *dir = opendir(cacheDirectory.c_str());
+    REQUIRE(dir);
+    while (const dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            REQUIRE(std::remove((cacheDirectory + "/" + entry->d_name).c_str()) == 0);
+        }
+    }
+    closedir(dir);
+    REQUIRE(rmdir(cacheDirectory.c_str()) == 0);
+    REQUIRE(rmdir(directory) == 0);
+}
+
+TEST_CASE("Thread policies parse", "[realtime]")
+{
+    using groggle::rt::ThreadPolicy;
+    ThreadPolicy policy;
+    REQUIRE(ThreadPolicy::parse("", &policy));
+    REQUIRE(policy.isDefault());
+
+    REQUIRE(ThreadPolicy::parse("fifo:80@2", &policy));
+    REQUIRE(policy.scheduler == ThreadPolicy::Scheduler::FIFO);
+    REQUIRE(policy.priority == 80);
+    REQUIRE(policy.cpu == 2);
+
+    REQUIRE(ThreadPolicy::parse("rr", &policy));
+    REQUIRE(policy.scheduler == ThreadPolicy::Scheduler::RR);
+    REQUIRE(policy.priority == 50);
+    REQUIRE(policy.cpu == -1);
+
+    REQUIRE(ThreadPolicy::parse("@1", &policy));
+    REQUIRE(policy.scheduler == ThreadPolicy::Scheduler::INHERIT);
+    REQUIRE(policy.cpu == 1);
+
+    REQUIRE_FALSE(ThreadPolicy::parse("fifo:0", &policy));
+    REQUIRE_FALSE(ThreadPolicy::parse("other:10", &policy));
+    REQUIRE_FALSE(ThreadPolicy::parse("idle", &policy));
+    REQUIRE_FALSE(ThreadPolicy::parse("fifo@x", &policy));
+}
+
+TEST_CASE("Quality governor steps down on misses and up with headroom", "[governor]")
+{
+    using groggle::QualityGovernor;
+    QualityGovernor governor(QualityGovernor::ladder(30, 44));
+    REQUIRE(governor.levelCount() == 4);
+    REQUIRE(governor.current().outputRate == 44);
+
+    // A single miss is tolerated, a second one in the same window is not
+    REQUIRE_FALSE(governor.report(true, 0.9f));
+    REQUIRE(governor.report(true, 1.2f));
+    REQUIRE(governor.level() == 1);
+    REQUIRE(governor.current().outputRate == 30);
+
+    for (int i = 0; i < 10; i++) {
+        governor.report(true, 1.5f);
+    }
+    REQUIRE(governor.level() == governor.levelCount() - 1);
+    REQUIRE(governor.current().decimation == 4);
+
+    // Busy but on time is not enough to step up
+    int changes = 0;
+    for (int i = 0; i < 1000; i++) {
+        changes += governor.report(false, 0.8f);
+    }
+    REQUIRE(changes == 0);
+
+    // Eight clean windows, plus the rest of the busy one
+    for (int i = 0; i < 9 * 32; i++) {
+        changes += governor.report(false, 0.2f);
+    }
+    REQUIRE(changes == 1);
+    REQUIRE(governor.level() == governor.levelCount() - 2);
+}
+
+TEST_CASE("Patches compile into per universe channel writes", "[patch]")
+{
+    using namespace groggle;
+    const ProfileLibrary &profiles = ProfileLibrary::builtin();
+    Patch patch;
+    REQUIRE(Patch::parse(R"({ "fixtures": [
+        { "universe": 3, "address": 1, "type": "rgb", "role": "treble", "count": 2 },
+        { "universe": 1, "address": 70, "type": "tripar" }
+    ] })", profiles, &patch));
+    REQUIRE(patch.fixtures().size() == 3);
+    REQUIRE(patch.fixtures()[1].address == 4);
+
+    const ChannelPlan plan(patch);
+    REQUIRE(plan.universes() == std::vector<uint16_t> { 1, 3 });
+    REQUIRE(plan.writeCount() == 4 + 3 + 3);
+
+    std::vector<uint16_t> levels(3 * level::COUNT);
+    for (size_t i = 0; i < levels.size(); i++) {
+        levels[i] = i << 8;
+    }
+    std::vector<uint8_t> channels(2 * UNIVERSE_SIZE, 0);
+    plan.apply(levels.data(), channels.data());
+
+    // The Tripar gets the plain color and its own dimmer
+    REQUIRE(channels[69] == 2 * level::COUNT + level::plain(Function::RED));
+    REQUIRE(channels[71] == 2 * level::COUNT + level::plain(Function::BLUE));
+    REQUIRE(channels[72] == 0);
+    REQUIRE(channels[74] == 2 * level::COUNT + level::INTENSITY);
+
+    // RGB fixtures have the dimming baked into the color
+    REQUIRE(channels[UNIVERSE_SIZE + 0] == level::dimmed(Function::RED));
+    REQUIRE(channels[UNIVERSE_SIZE + 5] == level::COUNT + level::dimmed(Function::BLUE));
+    REQUIRE(channels[UNIVERSE_SIZE + 6] == 0);
+
+    REQUIRE_FALSE(Patch::parse(R"({ "fixtures": [ { "universe": 1, "address": 510, "type": "tripar" } ] })", profiles, &patch));
+    REQUIRE_FALSE(Patch::parse(R"({ "fixtures": [ { "universe": 1, "address": 1, "type": "laser" } ] })", profiles, &patch));
+    REQUIRE_FALSE(Patch::parse(R"({ "fixtures": [ { "universe": 1, "address": 1, "type": "rgb", "role": "vocals" } ] })", profiles, &patch));
+    REQUIRE_FALSE(Patch::parse("not json", profiles, &patch));
+    REQUIRE(patch.fixtures().size() == 3);
+}
+
+TEST_CASE("Fixture profiles cover white, fine and fixed channels", "[patch]")
+{
+    using namespace groggle;
+    ProfileLibrary profiles = ProfileLibrary::builtin();
+    REQUIRE(profiles.find("rgbw"));
+    REQUIRE_FALSE(profiles.find("spot"));
+    REQUIRE(profiles.parse(R"({ "profiles": [
+        { "name": "spot", "channels": [ "dimmer", "dimmer fine", { "function": "tilt", "value": 0.25 }, "white" ] }
+    ] })"));
+    REQUIRE(profiles.find("spot")->mix() == 1);
+    REQUIRE_FALSE(profiles.parse(R"({ "profiles": [ { "name": "bad", "channels": [ "strobe" ] } ] })"));
+
+    Patch patch(profiles);
+    REQUIRE(patch.add(1, 1, "spot", Role::MID));
+    REQUIRE(patch.add(1, 5, "rgbw", Role::BASS));
+    REQUIRE(patch.add(1, 9, "movinghead", Role::BASS));
+
+    // Half white: all of it goes to the white channels
+    const float rgb[3] = { 0.5f, 0.5f, 0.5f };
+    const float intensities[ROLE_COUNT] = { 1.0f, 0.75f, 0.0f };
+    std::vector<uint16_t> levels(patch.fixtures().size() * level::COUNT);
+    for (size_t f = 0; f < patch.fixtures().size(); f++) {
+        const Patch::Fixture &fixture = patch.fixtures()[f];
+        level::compute(rgb, profiles.at(fixture.profile).mix(), intensities[static_cast<size_t>(fixture.role)],
+                       &levels[f * level::COUNT]);
+    }
+
+    std::vector<uint8_t> channels(UNIVERSE_SIZE, 0);
+    ChannelPlan(patch).apply(levels.data(), channels.data());
+    REQUIRE(channels[0] == 0xbf); // 0.75 * 65535 = 0xbfff
+    REQUIRE(channels[1] == 0xff);
+    REQUIRE(channels[2] == 0x40);
+    REQUIRE(channels[3] == 0x80); // No dimming, the dimmer channel does that
+    REQUIRE(channels[4] == 0);
+    REQUIRE(channels[6] == 0);
+    REQUIRE(channels[7] == 0x80);
+    REQUIRE(channels[8] == 0x80); // Pan centered
+    REQUIRE(channels[12] == 0xff);
+
+    // Patched over the moving head's tilt, the later fixture wins there too
+    REQUIRE(patch.add(1, 11, "dimmer", Role::BASS));
+    levels.resize(patch.fixtures().size() * level::COUNT);
+    levels[3 * level::COUNT + level::INTENSITY] = 0xffff;
+    ChannelPlan(patch).apply(levels.data(), channels.data());
+    REQUIRE(channels[8] == 0x80);
+    REQUIRE(channels[10] == 0xff);
+}
+
+TEST_CASE("Channels go through response curves and dithering", "[patch]")
+{
+    using namespace groggle;
+    ProfileLibrary profiles = ProfileLibrary::builtin();
+    REQUIRE(profiles.parse(R"({ "profiles": [ { "name": "par", "gamma": 2, "channels": [ "dimmer" ] } ] })"));
+    REQUIRE_FALSE(profiles.parse(R"({ "profiles": [ { "name": "bad", "gamma": 0, "channels": [ "dimmer" ] } ] })"));
+
+    Patch patch(profiles);
+    REQUIRE(patch.add(1, 1, "par", Role::BASS));
+    REQUIRE(patch.add(1, 2, "dimmer", Role::BASS));
+    REQUIRE(patch.add(1, 3, "dimmer16", Role::BASS));
+
+    std::vector<uint16_t> levels(3 * level::COUNT, 0);
+    for (size_t f = 0; f < 3; f++) {
+        levels[f * level::COUNT + level::INTENSITY] = f == 0 ? 0x8000 : 0x0180; // 1.5 in the high byte
+    }
+
+    std::vector<uint8_t> channels(UNIVERSE_SIZE, 0);
+    const ChannelPlan plain(patch);
+    plain.apply(levels.data(), channels.data());
+    REQUIRE(channels[0] == 0x40); // Half squared
+    REQUIRE(channels[1] == 1);
+
+    // Dithered, the 8 bit dimmer averages out at 1.5, the 16 bit one stays put
+    const ChannelPlan dithered(patch, true);
+    int sum = 0;
+    for (uint32_t frame = 0; frame < 8; frame++) {
+        dithered.apply(levels.data(), channels.data(), frame);
+        sum += channels[1];
+        REQUIRE(channels[2] == 1);
+        REQUIRE(channels[3] == 0x80);
+    }
+    REQUIRE(sum == 12);
+
+    // Full and off stay full and off
+    levels[level::COUNT + level::INTENSITY] = UINT16_MAX;
+    dithered.apply(levels.data(), channels.data(), 7);
+    REQUIRE(channels[1] == 0xff);
+    levels[level::COUNT + level::INTENSITY] = 0;
+    dithered.apply(levels.data(), channels.data(), 7);
+    REQUIRE(channels[1] == 0);
+}
+
+TEST_CASE("Effect chains run per fixture group", "[effects]")
+{
+    using namespace groggle;
+    Patch patch;
+    REQUIRE(Patch::parse(R"({ "fixtures": [
+        { "universe": 1, "address": 1, "type": "rgb", "group": "chase", "count": 4 },
+        { "universe": 1, "address": 13, "type": "dimmer", "role": "mid" },
+        { "universe": 1, "address": 14, "type": "rgb", "group": "flash" }
+    ], "effects": {
+        "chase": [ { "type": "chase", "rate": 0.25 } ],
+        "flash": [ { "type": "band", "role": "treble" }, { "type": "flash", "length": 0.5 } ]
+    } })", ProfileLibrary::builtin(), &patch));
+    REQUIRE(patch.fixtures()[4].group == "mid");
+    REQUIRE_FALSE(Patch::parse(R"({ "fixtures": [ { "universe": 1, "address": 1, "type": "rgb" } ],
+        "effects": { "front": [ { "type": "band" } ] } })", ProfileLibrary::builtin(), &patch));
+    REQUIRE_FALSE(Patch::parse(R"({ "fixtures": [ { "universe": 1, "address": 1, "type": "rgb" } ],
+        "effects": { "bass": [ { "type": "laser" } ] } })", ProfileLibrary::builtin(), &patch));
+
+    EffectEngine engine(patch);
+    REQUIRE(engine.instructionCount() == 4);
+
+    EffectInputs inputs;
+    inputs.rgb[0] = 1.0f;
+    inputs.bands[static_cast<size_t>(Role::MID)] = 0.5f;
+    std::vector<uint16_t> levels(patch.fixtures().size() * level::COUNT);
+    const auto red = [&](const size_t fixture) { return levels[fixture * level::COUNT + level::dimmed(Function::RED)]; };
+
+    // A quarter of the way around, the spot is on the second fixture
+    engine.run(inputs, 1.0f, levels.data());
+    REQUIRE(red(0) == 0);
+    REQUIRE(red(1) == UINT16_MAX);
+    REQUIRE(red(2) == 0);
+    REQUIRE(levels[4 * level::COUNT + level::INTENSITY] == 0x8000);
+    REQUIRE(red(5) == 0);
+
+    // Halfway to the third one, the flash fades from full to half
+    inputs.onsets[static_cast<size_t>(Role::BASS)] = true;
+    engine.run(inputs, 0.5f, levels.data());
+    REQUIRE(red(1) == 0x8000);
+    REQUIRE(red(2) == 0x8000);
+    REQUIRE(red(5) == UINT16_MAX);
+    inputs.onsets[static_cast<size_t>(Role::BASS)] = false;
+    engine.run(inputs, 0.25f, levels.data());
+    REQUIRE(red(5) == 0x8000);
+}
+
+TEST_CASE("LED strips continue in the next universes", "[pixelmap]")
+{
+    using namespace groggle;
+    Patch patch;
+    REQUIRE(Patch::parse(R"({ "strips": [
+        { "universe": 5, "address": 508, "pixels": 200, "order": "grb" },
+        { "universe": 9, "address": 1, "pixels": 10, "mode": "vu", "role": "mid" }
+    ] })", ProfileLibrary::builtin(), &patch));
+    REQUIRE(patch.strips()[0].lastUniverse() == 7);
+
+    const ChannelPlan plan(patch);
+    REQUIRE(plan.universes() == std::vector<uint16_t> { 5, 6, 7, 9 });
+
+    PixelMap map(patch, plan);
+    REQUIRE(map.pixelCount() == 210);
+
+    // Loud everywhere, the mid level reaches 4 of the VU meter's 10 pixels
+    audio::Spectrum spectrum(512, 1.0f);
+    const float rgb[3] = { 1.0f, 0.5f, 0.0f };
+    const float intensities[ROLE_COUNT] = { 0.0f, 0.4f, 0.0f };
+    std::vector<uint8_t> channels(4 * UNIVERSE_SIZE, 0);
+    map.render(spectrum, rgb, intensities, 0.5f, channels.data());
+
+    // The first pixel fits at the end of universe 5, in GRB
+    REQUIRE(channels[507] == 128);
+    REQUIRE(channels[508] == 255);
+    REQUIRE(channels[509] == 0);
+    REQUIRE(channels[510] == 0);
+    // 169 pixels later universe 7 starts with the 171st
+    REQUIRE(channels[UNIVERSE_SIZE + 170 * 3 - 2] == 255);
+    REQUIRE(channels[UNIVERSE_SIZE + 170 * 3] == 0);
+    REQUIRE(channels[2 * UNIVERSE_SIZE + 1] == 255);
+    REQUIRE(channels[2 * UNIVERSE_SIZE + 28 * 3 + 1] == 255);
+    REQUIRE(channels[2 * UNIVERSE_SIZE + 29 * 3 + 1] == 0);
+
+    const uint8_t *vu = &channels[3 * UNIVERSE_SIZE];
+    REQUIRE(vu[3 * 3] == 255);
+    REQUIRE(vu[3 * 3 + 1] == 128);
+    REQUIRE(vu[4 * 3] == 0);
+
+    // Silence: the peaks fall off
+    audio::Spectrum silence(512, 0.0f);
+    const float quiet[ROLE_COUNT] = {};
+    map.render(silence, rgb, quiet, 0.5f, channels.data());
+    REQUIRE(channels[508] == 128);
+    REQUIRE(vu[0] == 128);
+    REQUIRE(vu[4 * 3] == 0);
+}
+
+TEST_CASE("Unchanged universes wait for the keepalive", "[patch]")
+{
+    using namespace groggle;
+    ChangeFilter filter(1000);
+    DmxFrame frame;
+    frame.universes = { 1, 2 };
+    frame.channels.assign(2 * UNIVERSE_SIZE, 0);
+
+    DmxFrame changed;
+    REQUIRE(filter.apply(frame, 0, &changed));
+    REQUIRE(changed.universes.size() == 2);
+    REQUIRE_FALSE(filter.apply(frame, 10, &changed));
+
+    frame.channels[UNIVERSE_SIZE + 3] = 1;
+    REQUIRE(filter.apply(frame, 20, &changed));
+    REQUIRE(changed.universes == std::vector<uint16_t> { 2 });
+    REQUIRE(changed.data(0)[3] == 1);
+
+    // Universe 1 is due first
+    REQUIRE(filter.apply(frame, 1000, &changed));
+    REQUIRE(changed.universes == std::vector<uint16_t> { 1 });
+    REQUIRE(filter.sent() == 4);
+    REQUIRE(filter.skipped() == 4);
+
+    ChangeFilter everything(0);
+    REQUIRE(everything.apply(frame, 0, &changed));
+    REQUIRE(everything.apply(frame, 0, &changed));
+    REQUIRE(changed.universes.size() == 2);
+}
+
+/// UDP socket on an ephemeral loopback port
+static int listenLoopback(uint16_t *port)
+{
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), length) != 0
+            || getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    timeval timeout = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    *port = ntohs(address.sin_port);
+    return fd;
+}
+
+TEST_CASE("Art-Net frames arrive with a sync", "[net]")
+{
+    using namespace groggle;
+    uint16_t port = 0;
+    const int fd = listenLoopback(&port);
+    REQUIRE(fd >= 0);
+
+    DmxFrame frame;
+    frame.universes = { 1, 0x123 };
+    frame.channels.assign(2 * UNIVERSE_SIZE, 0);
+    frame.channels[0] = 42;
+    frame.channels[UNIVERSE_SIZE + 511] = 7;
+
+    net::Sender sender(net::Protocol::ARTNET, "127.0.0.1", port);
+    REQUIRE(sender.isOpen());
+    REQUIRE(sender.send(frame));
+
+    uint8_t packet[1024];
+    REQUIRE(recv(fd, packet, sizeof(packet), 0) == net::ARTDMX_SIZE);
+    REQUIRE(memcmp(packet, "Art-Net", 8) == 0);
+    REQUIRE(packet[8] == 0x00);
+    REQUIRE(packet[9] == 0x50);
+    REQUIRE(packet[12] == 1); // Sequence
+    REQUIRE(packet[14] == 1);
+    REQUIRE(packet[18] == 42);
+
+    REQUIRE(recv(fd, packet, sizeof(packet), 0) == net::ARTDMX_SIZE);
+    REQUIRE(packet[14] == 0x23);
+    REQUIRE(packet[15] == 0x01);
+    REQUIRE(packet[18 + 511] == 7);
+
+    REQUIRE(recv(fd, packet, sizeof(packet), 0) == net::ARTSYNC_SIZE);
+    REQUIRE(packet[9] == 0x52);
+    close(fd);
+}
+
+TEST_CASE("Universes are checked against the protocol's range", "[net]")
+{
+    using groggle::net::Protocol;
+    REQUIRE(groggle::net::isValidUniverse(Protocol::ARTNET, 0));
+    REQUIRE(groggle::net::isValidUniverse(Protocol::ARTNET, 0x7fff));
+    REQUIRE_FALSE(groggle::net::isValidUniverse(Protocol::ARTNET, 0x8000));
+    REQUIRE_FALSE(groggle::net::isValidUniverse(Protocol::SACN, 0));
+    REQUIRE(groggle::net::isValidUniverse(Protocol::SACN, 1));
+    REQUIRE(groggle::net::isValidUniverse(Protocol::SACN, 63999));
+    REQUIRE_FALSE(groggle::net::isValidUniverse(Protocol::SACN, 64000));
+}
+
+TEST_CASE("sACN frames arrive with a sync", "[net]")
+{
+    using namespace groggle;
+    uint16_t port = 0;
+    const int fd = listenLoopback(&port);
+    REQUIRE(fd >= 0);
+
+    DmxFrame frame;
+    frame.universes = { 3, 4 };
+    frame.channels.assign(2 * UNIVERSE_SIZE, 0);
+    frame.channels[UNIVERSE_SIZE] = 99;
+
+    net::Sender sender(net::Protocol::SACN, "127.0.0.1", port);
+    REQUIRE(sender.send(frame));
+    REQUIRE(sender.send(frame));
+
+    uint8_t packet[1024];
+    uint8_t sequence = 0;
+    for (int i = 0; i < 2; i++) {
+        REQUIRE(recv(fd, packet, sizeof(packet), 0) == net::SACN_DATA_SIZE);
+        REQUIRE(memcmp(&packet[4], "ASC-E1.17", 10) == 0);
+        REQUIRE(((packet[16] << 8 | packet[17]) & 0x0fff) == net::SACN_DATA_SIZE - 16);
+        REQUIRE(packet[110] == 3); // Sync on the first universe
+        REQUIRE(packet[114] == 3);
+        sequence = packet[111];
+
+        REQUIRE(recv(fd, packet, sizeof(packet), 0) == net::SACN_DATA_SIZE);
+        REQUIRE(packet[114] == 4);
+        REQUIRE(packet[125] == 0); // START code
+        REQUIRE(packet[126] == 99);
+
+        REQUIRE(recv(fd, packet, sizeof(packet), 0) == net::SACN_SYNC_SIZE);
+        REQUIRE(packet[21] == 0x08);
+        REQUIRE(packet[46] == 3);
+    }
+    REQUIRE(sequence == 2);
+    close(fd);
+}
+
+TEST_CASE("Event loop dispatches descriptors and timers", "[eventloop]")
+{
+    groggle::EventLoop loop;
+    REQUIRE(loop.isOpen());
+
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    char received = 0;
+    REQUIRE(loop.add(fds[0], EPOLLIN, [&fds, &received](const uint32_t events) {
+        REQUIRE(events & EPOLLIN);
+        REQUIRE(read(fds[0], &received, 1) == 1);
+    }));
+
+    uint64_t expirations = 0;
+    const int timer = loop.addTimer(1000, [&expirations](const uint64_t count) {
+        expirations += count;
+    });
+    REQUIRE(timer >= 0);
+
+    REQUIRE(write(fds[1], "x", 1) == 1);
+    while (received == 0 || expirations == 0) {
+        loop.dispatch(100);
+    }
+    REQUIRE(received == 'x');
+
+    loop.removeTimer(timer);
+    loop.remove(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("Timer ticks on its deadlines", "[timer]")
+{
+    // 100 Hz for 200 ms: ticks at 10, 20, ..., 190 ms
+    groggle::Timer timer(0.2f, 100);
+    int ticks = 0;
+    long long lastElapsed = 0;
+    timer.setCallback([&ticks, &lastElapsed](const long long elapsed) {
+        REQUIRE(elapsed > lastElapsed);
+        lastElapsed = elapsed;
+        ticks++;
+    });
+    timer.run();
+
+    const groggle::Timer::Stats stats = timer.stats();
+    REQUIRE(stats.ticks == static_cast<uint64_t>(ticks));
+    REQUIRE(ticks + stats.skipped == 19);
+    REQUIRE(stats.meanLateness >= 0);
+    REQUIRE(stats.maxLateness >= stats.meanLateness);
+}
+
+TEST_CASE("Endless timer stops on request", "[timer]")
+{
+    groggle::Timer timer(0, 1000);
+    int ticks = 0;
+    timer.setCallback([&timer, &ticks](const long long) {
+        if (++ticks == 5) {
+            timer.stop();
+        }
+    });
+    timer.run();
+    REQUIRE(ticks == 5);
+
+    // Stopping is final, also for a run() that starts after it
+    timer.run();
+    REQUIRE(ticks == 5);
+}
+
+TEST_CASE("Paused timers run again", "[timer]")
+{
+    groggle::Timer timer(0, 1000);
+    int ticks = 0;
+    timer.setCallback([&timer, &ticks](const long long) {
+        if (++ticks % 3 == 0) {
+            timer.pause();
+        }
+    });
+    timer.run();
+    REQUIRE(ticks == 3);
+    timer.run();
+    REQUIRE(ticks == 6);
+
+    timer.stop();
+    timer.run();
+    REQUIRE(ticks == 6);
+}
@@ -1,51 +1,102 @@
 #include "timer.h"
 
+#include <algorithm> // max
 #include <cassert>
-#include <chrono>
+#include <cerrno>
 #include <cmath>
-#include <iostream>
-#include <unistd.h> // usleep
-
-using std::chrono::steady_clock;
+#include <ctime>
 
 namespace groggle
 {
 
+static const long long S_TO_NS = 1000 * 1000 * 1000;
+
+static long long toNs(const timespec &ts)
+{
+    return ts.tv_sec * S_TO_NS + ts.tv_nsec;
+}
+
+static timespec fromNs(const long long ns)
+{
+    timespec ts;
+    ts.tv_sec = ns / S_TO_NS;
+    ts.tv_nsec = ns % S_TO_NS;
+    return ts;
+}
+
+static long long now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return toNs(ts);
+}
+
 Timer::Timer(const float duration, const float frequency)
     : m_duration(duration * S_TO_NS)
     , m_pulseInterval(round(1 / frequency * S_TO_NS))
 {}
 
+void Timer::setFrequency(const float frequency)
+{
+    m_pulseInterval = round(1 / frequency * S_TO_NS);
+}
+
 void Timer::run()
 {
-    // TODO Support running *really* indefinitely. Reset 'start' every n minutes?
-    m_running = true;
-    const auto start = steady_clock::now();
-    long long elapsed = 0;
+    // 64 bit nanoseconds last for centuries, no need to ever reset 'start'.
+    // m_running is left alone here, so a stop() before run() is not lost.
+    m_paused = false;
+    const long long start = now();
     long long elapsedAtNextPulse = m_pulseInterval;
 
-    do {
-        const auto elapsedSpan = steady_clock::now() - start;
-        elapsed = elapsedSpan.count();
+    while (m_running && !m_paused && (m_duration <= 0 || elapsedAtNextPulse < m_duration)) {
+        const timespec deadline = fromNs(start + elapsedAtNextPulse);
+        int result = 0;
+        do {
+            result = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr);
+        } while (result == EINTR);
 
-        if (elapsed >= elapsedAtNextPulse) {
-            m_tick(elapsed);
+        if (!m_running) {
+            break;
+        }
 
-            const auto elapsedSpanAfterTick = steady_clock::now() - start;
-            int steps = 0;
-            while (elapsedAtNextPulse < elapsedSpanAfterTick.count()) {
-                elapsedAtNextPulse += m_pulseInterval;
-                steps++;
-            }
+        const long long elapsed = now() - start;
+        m_tick(elapsed);
 
-            if (steps > 1) {
-                std::cerr << "Timer: Skipped " << steps - 1 << " pulses!\n";
-            }
-            assert(elapsedAtNextPulse > elapsedSpanAfterTick.count());
+        // Catch up if the tick overran one or more intervals
+        const long long elapsedAfterTick = now() - start;
+        const long long lateness = elapsed - elapsedAtNextPulse;
+        const long long interval = m_pulseInterval;
+        uint64_t skipped = 0;
+        elapsedAtNextPulse += interval;
+        while (elapsedAtNextPulse <= elapsedAfterTick) {
+            elapsedAtNextPulse += interval;
+            skipped++;
         }
 
-        usleep( 1 /*ms*/ * 1000 );
-    } while ( m_duration > 0 ? elapsed < m_duration : m_running );
+        assert(elapsedAtNextPulse > elapsedAfterTick);
+        record(lateness, skipped);
+    }
+}
+
+Timer::Stats Timer::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
+}
+
+void Timer::record(const long long lateness, const uint64_t skipped)
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats.ticks++;
+    m_stats.skipped += skipped;
+    m_stats.maxLateness = std::max(m_stats.maxLateness, lateness);
+
+    // Welford's online variance
+    const double delta = lateness - m_stats.meanLateness;
+    m_stats.meanLateness += delta / m_stats.ticks;
+    m_latenessM2 += delta * (lateness - m_stats.meanLateness);
+    m_stats.jitter = std::sqrt(m_latenessM2 / m_stats.ticks);
 }
 
 }
@@ -1,31 +1,69 @@
 #ifndef TIMER
 #define TIMER
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <mutex>
 
 namespace groggle
 {
 
+/**
+ * Calls back at a fixed rate. Sleeps until absolute deadlines on the
+ * monotonic clock, so there are no idle wakeups and errors do not add up.
+ */
 class Timer
 {
 public:
     typedef std::function<void(long long)> Callback;
 
+    struct Stats
+    {
+        uint64_t ticks = 0;
+        uint64_t skipped = 0; // Pulses dropped because a tick took too long
+        long long maxLateness = 0; // ns between deadline and callback
+        double meanLateness = 0; // ns
+        double jitter = 0; // ns, standard deviation of the lateness
+    };
+
+    /**
+     * @param duration Run time in s, 0 runs until stop() is called
+     * @param frequency Ticks per second
+     */
     Timer(const float duration, const float frequency);
     void setCallback(Callback tick) {
         m_tick = tick;
     }
+    /// Blocks until the duration has passed, or pause() or stop() was called.
     void run();
+    /**
+     * Thread safe and final, later calls to run() return right away. Takes
+     * effect after the current interval at the latest.
+     */
     void stop() {
         m_running = false;
     }
+    /// From the callback only. Returns from run() after this tick, run() may be called again.
+    void pause() {
+        m_paused = true;
+    }
+    /// Thread safe. Takes effect from the next pulse on.
+    void setFrequency(const float frequency);
+    Stats stats() const;
 
 private:
-    const long long S_TO_NS = 1000 * 1000 * 1000;
+    void record(const long long lateness, const uint64_t skipped);
+
     const long long m_duration;
-    const long long m_pulseInterval;
-    bool m_running = false;
+    std::atomic<long long> m_pulseInterval;
+    std::atomic<bool> m_running { true }; // Until stop()
+    bool m_paused = false; // Only touched on the thread in run()
     Callback m_tick = [](const long long) {};
+
+    mutable std::mutex m_statsMutex;
+    Stats m_stats;
+    double m_latenessM2 = 0; // Running sum of squared deviations
 };
 
 }